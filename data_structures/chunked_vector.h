@@ -0,0 +1,87 @@
+/* Chunked Vector
+ * USAGE
+ *  chunked_vector<T> arr; vector whose elements never move
+ *  chunked_vector<T> arr(n); n default constructed elements
+ * MEMBERS
+ *  size(), empty(), back(), operator[] as usual
+ *  T& emplace_back(args...); push_back(v); pop_back(); resize(n); clear();
+ *  reserve(n); allocates the chunks for n elements up front
+ * NOTES
+ *  fixed chunks of 2^chunk_bits elements, so growth allocates a new chunk instead of
+ *  copying everything, and references/indices stay valid. an access is a shift and a mask
+ *  (chunks[i >> chunk_bits][i & mask]), at most one chunk is partially used
+ * TIME
+ *  O(1) access, O(1) emplace_back
+ * STATUS
+ *  untested
+ */
+#pragma once
+
+#include <cstddef>
+#include <memory>
+#include <utility>
+#include <vector>
+
+template <typename T, size_t chunk_bits = 12>
+struct chunked_vector {
+  static constexpr size_t chunk_size = size_t(1) << chunk_bits;
+  static constexpr size_t mask = chunk_size - 1;
+  std::vector<T*> chunks;
+  size_t _size = 0;
+
+  chunked_vector() = default;
+  chunked_vector(size_t n) { resize(n); }
+  chunked_vector(chunked_vector const& o) {
+    reserve(o.size());
+    for (size_t i = 0; i < o.size(); i++) emplace_back(o[i]);
+  }
+  chunked_vector(chunked_vector&& o) noexcept
+      : chunks(std::exchange(o.chunks, {})), _size(std::exchange(o._size, 0)) {}
+  auto operator=(chunked_vector o) -> chunked_vector& {
+    swap(o);
+    return *this;
+  }
+  ~chunked_vector() {
+    clear();
+    for (size_t k = 0; k < chunks.size(); k++) {
+      std::allocator<T>().deallocate(chunks[k], chunk_size);
+    }
+  }
+  auto swap(chunked_vector& o) noexcept -> void {
+    std::swap(chunks, o.chunks);
+    std::swap(_size, o._size);
+  }
+
+  auto size() const -> size_t { return _size; }
+  auto empty() const -> bool { return _size == 0; }
+  auto capacity() const -> size_t { return chunks.size() << chunk_bits; }
+
+  auto operator[](size_t i) -> T& { return chunks[i >> chunk_bits][i & mask]; }
+  auto operator[](size_t i) const -> T const& { return chunks[i >> chunk_bits][i & mask]; }
+  auto back() -> T& { return (*this)[_size - 1]; }
+  auto back() const -> T const& { return (*this)[_size - 1]; }
+
+  auto reserve(size_t n) -> void {
+    while (capacity() < n) {
+      chunks.push_back(std::allocator<T>().allocate(chunk_size));
+    }
+  }
+  template <typename... Args>
+  auto emplace_back(Args&&... args) -> T& {
+    reserve(_size + 1);
+    T* const ptr = std::construct_at(&(*this)[_size], std::forward<Args>(args)...);
+    _size++;
+    return *ptr;
+  }
+  auto push_back(T const& v) -> void { emplace_back(v); }
+  auto pop_back() -> void {
+    std::destroy_at(&back());
+    _size--;
+  }
+  auto resize(size_t n) -> void {
+    reserve(n);
+    while (_size < n) emplace_back();
+    while (_size > n) pop_back();
+  }
+  auto clear() -> void { resize(0); }
+};
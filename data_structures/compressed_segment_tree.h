@@ -0,0 +1,229 @@
+/* Compressed Segment Tree
+ * USAGE
+ *  compressed_segment_tree<node_t> segtree(n); dynamic segment tree on [0, n), int64_t
+ *  compressed_segment_tree<node_t> segtree(n, capacity); preallocates nodes
+ *  node_t is the same as for segment_tree (data_structures/segment_tree.h) without push,
+ *    ie. put, get, merge, pull, accumulate, contains
+ *    put may take a segment_length_t first, a missing child is read as node_t()
+ * MEMBERS
+ *  update_range(l, r, value...);
+ *  update_point(x, value...);
+ *  query_range(l, r, ...);
+ *  query_point(x, ...);
+ *  search_left(l, r, ...); returns lim if not found
+ *  All ranges are inclusive
+ * NOTES
+ *  like SPARSE segment_tree, but a child can be any dyadic segment inside its half, so
+ *  unary chains are skipped (patricia trie over the coordinates). a point update adds at
+ *  most 2 nodes instead of log2(n), a range update adds O(1) nodes per canonical segment
+ * TIME
+ *  O(logN) per operation
+ *  N = n
+ * STATUS
+ *  untested
+ */
+#pragma once
+
+#include "data_structures/chunked_vector.h"
+#include "data_structures/segment_tree.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstdint>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+
+template <typename Node_t>
+struct compressed_segment_tree {
+  using node_t = Node_t;
+  using coordinate_t = int64_t;
+  template <typename... Args>
+  using return_t = segment_tree_details::return_getter<node_t, Args...>::type;
+
+  static_assert(
+      not requires(node_t nd, node_t& nd_ref) { nd.push(nd_ref, nd_ref); } and
+          not requires(node_t nd, node_t& nd_ref, segment_length_t sl) {
+            nd.push(nd_ref, nd_ref, sl);
+          },
+      "compressed_segment_tree does not support push, use accumulate instead");
+  static constexpr bool has_pull =
+      requires(node_t nd, node_t const& nd_cref) { nd.pull(nd_cref, nd_cref); };
+  template <typename... Args>
+  static constexpr bool use_pull_as_merge =
+      has_pull && not requires(return_t<Args...> ret, Args const&... args) {
+        node_t::merge(ret, ret, args...);
+      } && std::is_same_v<node_t, return_t<Args...>>;
+
+  struct segment_t {
+    coordinate_t lo;
+    int level;  // covers [lo, lo + 2^level)
+  };
+
+  coordinate_t lim, length;
+  chunked_vector<node_t> data;
+  chunked_vector<segment_tree_children_t> children;
+  chunked_vector<segment_t> segments;
+
+  static auto get_power2(int64_t n) -> int64_t {
+    return 1ll << (n <= 1 ? 0 : 64 - std::countl_zero((uint64_t)n - 1));
+  }
+  compressed_segment_tree(coordinate_t n, size_t capacity = 0)
+      : lim(n), length(get_power2(lim)), data(2), children(2), segments(2) {
+    data.reserve(capacity);
+    children.reserve(capacity);
+    segments.reserve(capacity);
+    segments[1] = segment_t{0, std::countr_zero((uint64_t)length)};
+  }
+
+  auto root() -> node_t& { return data[1]; }
+  auto seg_l(int i) const -> coordinate_t { return segments[i].lo; }
+  auto seg_r(int i) const -> coordinate_t {
+    return segments[i].lo + (1ll << segments[i].level) - 1;
+  }
+  auto covered(int i, coordinate_t l, coordinate_t r) const -> bool {
+    return l <= seg_l(i) && seg_r(i) <= r;
+  }
+  auto intersects(int i, coordinate_t l, coordinate_t r) const -> bool {
+    return i != 0 && l <= seg_r(i) && seg_l(i) <= r;
+  }
+
+  auto make_node(coordinate_t lo, int level) -> int {
+    data.emplace_back();
+    children.emplace_back();
+    segments.emplace_back(lo, level);
+    return (int)data.size() - 1;
+  }
+  auto child_slot(int i, coordinate_t x) -> int& {
+    return (x >> (segments[i].level - 1) & 1) ? children[i].right : children[i].left;
+  }
+  auto pull(int i) -> void { data[i].pull(data[children[i].left], data[children[i].right]); }
+
+  // returns the child of i whose segment contains [lo, lo + 2^level), creating it (and a
+  // branching node above the old child if they are disjoint) if necessary
+  auto attach(int i, coordinate_t lo, int level) -> int {
+    int& slot = child_slot(i, lo);
+    int const c = slot;
+    if (not c) return slot = make_node(lo, level);
+    auto const [c_lo, c_level] = segments[c];
+    if (level <= c_level && (lo >> c_level) == (c_lo >> c_level)) return c;
+    int const top_level = std::max(level, (int)std::bit_width((uint64_t)(lo ^ c_lo)));
+    int const top = make_node(lo >> top_level << top_level, top_level);
+    child_slot(top, c_lo) = c;
+    if constexpr (has_pull) pull(top);
+    return slot = top;
+  }
+
+  // Updates
+
+  template <typename... Args>
+  auto put(int i, Args const&... args) -> void {
+    if constexpr (requires { data[i].put(args...); }) data[i].put(args...);
+    else data[i].put(segment_length_t{seg_r(i) - seg_l(i) + 1}, args...);
+  }
+
+  template <typename... Args>
+  auto update_range(coordinate_t l, coordinate_t r, Args const&... args) -> void {
+    if (r < l) return;  // empty range
+    if (l < 0 || lim <= r) throw std::invalid_argument("update range out of bounds");
+    if (covered(1, l, r)) return put(1, args...);
+    _update_range(l, r, 1, args...);
+  }
+  template <typename... Args>
+  auto update_point(coordinate_t x, Args const&... args) -> void {
+    update_range(x, x, args...);
+  }
+  template <typename... Args>
+  auto _update_range(
+      coordinate_t const l, coordinate_t const r, int const i, Args const&... args) -> void {
+    coordinate_t const mid = seg_l(i) + (1ll << (segments[i].level - 1)) - 1;
+    for (auto const& [half_l, half_r] :
+         {std::pair(seg_l(i), mid), std::pair(mid + 1, seg_r(i))}) {
+      coordinate_t const ql = std::max(l, half_l), qr = std::min(r, half_r);
+      if (qr < ql) continue;
+      // smallest dyadic segment containing [ql, qr]
+      int const level = (int)std::bit_width((uint64_t)(ql ^ qr));
+      int const j = attach(i, ql >> level << level, level);
+      if (covered(j, ql, qr)) put(j, args...);
+      else _update_range(ql, qr, j, args...);
+    }
+    if constexpr (has_pull) pull(i);
+  }
+
+  // Queries
+
+  template <typename... Args>
+  auto query_range(coordinate_t l, coordinate_t r, Args const&... args) -> return_t<Args...>
+    requires(requires(node_t nd) { nd.get(args...); })
+  {
+    if (r < l) return data[0].get(args...);
+    if (l < 0 || lim <= r) throw std::invalid_argument("query range out of bounds");
+    return _query_range(l, r, 1, args...);
+  }
+  template <typename... Args>
+  auto query_point(coordinate_t x, Args const&... args) -> return_t<Args...>
+    requires(requires(node_t nd) { nd.get(args...); })
+  {
+    return query_range(x, x, args...);
+  }
+
+  template <typename acc_t, typename... Args>
+    requires(has_segment_accumulate<node_t, acc_t, Args...>)
+  auto _query_range(
+      coordinate_t const l, coordinate_t const r, int const i, acc_t const& acc,
+      Args const&... args) -> return_t<acc_t, Args...> {
+    if constexpr (has_segment_accumulate_without_length<node_t, acc_t, Args...>) {
+      return _query_range_impl(l, r, i, data[i].accumulate(acc, args...), args...);
+    } else {
+      return _query_range_impl(
+          l, r, i, data[i].accumulate(acc, segment_length_t{seg_r(i) - seg_l(i)}, args...),
+          args...);
+    }
+  }
+  template <typename... Args>
+  auto _query_range(
+      coordinate_t const l, coordinate_t const r, int const i, Args const&... args)
+      -> return_t<Args...> {
+    return _query_range_impl(l, r, i, args...);
+  }
+  template <typename... Args>
+  auto _query_range_impl(
+      coordinate_t const l, coordinate_t const r, int const i, Args const&... args)
+      -> return_t<Args...> {
+    if (covered(i, l, r)) return data[i].get(args...);
+    int const left = children[i].left, right = children[i].right;
+    bool const go_left = intersects(left, l, r);
+    bool const go_right = intersects(right, l, r);
+    if (not go_left and not go_right) return data[0].get(args...);
+    if (not go_right) return _query_range(l, r, left, args...);
+    if (not go_left) return _query_range(l, r, right, args...);
+    if constexpr (use_pull_as_merge<Args...>) {
+      return node_t().pull(
+          _query_range(l, r, left, args...), _query_range(l, r, right, args...));
+    } else {
+      return node_t::merge(
+          _query_range(l, r, left, args...), _query_range(l, r, right, args...), args...);
+    }
+  }
+
+  // Binary search
+
+  template <typename... Args>
+  auto search_left(coordinate_t l, coordinate_t r, Args... args) -> coordinate_t {
+    if (r < l) return lim;
+    if (l < 0 || lim <= r) throw std::invalid_argument("search_left out of bounds");
+    return _search_left(l, r, 1, args...);
+  }
+  template <typename... Args>
+  auto _search_left(coordinate_t const l, coordinate_t const r, int const i, Args&... args)
+      -> coordinate_t {
+    if (covered(i, l, r) && not data[i].contains(args...)) return lim;
+    if (segments[i].level == 0) return seg_l(i);
+    coordinate_t res = lim;
+    if (intersects(children[i].left, l, r)) res = _search_left(l, r, children[i].left, args...);
+    if (res == lim && intersects(children[i].right, l, r)) {
+      res = _search_left(l, r, children[i].right, args...);
+    }
+    return res;
+  }
+};
@@ -0,0 +1,64 @@
+/* Disjoint Sparse Table
+ * USAGE
+ *  disjoint_sparse_table<Type, Functional> rq(arr);
+ *  disjoint_sparse_table<Type, Functional> rq(begin, end, func); func is copied
+ *  auto val = rq.query(l, r); func(arr[l], ..., arr[r]) in this order
+ *    inclusive range [l, r]
+ *    assumes l <= r
+ * NOTES
+ *  Functional only needs to be associative (sums, mod_int products, matrix products), unlike
+ *  sparse_table whose two blocks overlap. layer h splits the array into blocks of 2^h, each
+ *  position stores the fold from itself to the middle of its block, so [l, r] with l != r
+ *  is answered by the two folds of layer bit_width(l ^ r) around their common middle
+ * TIME
+ *  O(NlogN) construction, O(Functional) query
+ *  N = |array|
+ * STATUS
+ *  untested
+ */
+#pragma once
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <iterator>
+#include <ranges>
+#include <utility>
+#include <vector>
+
+template <typename T, typename Func>
+struct disjoint_sparse_table {
+  size_t const n;
+  std::vector<T> data;  // layer 0 is the array itself
+  [[no_unique_address]] mutable Func func;  // mutable, Func::operator() need not be const
+  template <std::input_iterator input_it>
+  disjoint_sparse_table(input_it s, input_it t, Func _func = Func())
+      : n(std::distance(s, t)), func(std::move(_func)) {
+    size_t const layers = n <= 1 ? 1 : std::bit_width(n - 1) + 1;
+    data.reserve(n * layers);
+    data.insert(data.end(), s, t);
+    data.resize(n * layers, data.empty() ? T() : data[0]);
+    T const* const arr = data.data();
+    for (size_t h = 1; h < layers; h++) {
+      T* const cur = data.data() + h * n;
+      for (size_t mid = size_t(1) << (h - 1); mid < n; mid += size_t(1) << h) {
+        cur[mid - 1] = arr[mid - 1];
+        for (size_t i = mid - 1; i-- > mid - (size_t(1) << (h - 1));) {
+          cur[i] = func(arr[i], cur[i + 1]);
+        }
+        size_t const end = std::min(n, mid + (size_t(1) << (h - 1)));
+        cur[mid] = arr[mid];
+        for (size_t i = mid + 1; i < end; i++) cur[i] = func(cur[i - 1], arr[i]);
+      }
+    }
+  }
+  template <std::ranges::input_range range_t>
+  disjoint_sparse_table(range_t const& arr, Func _func = Func())
+      : disjoint_sparse_table(
+            std::ranges::begin(arr), std::ranges::end(arr), std::move(_func)) {}
+  auto query(size_t l, size_t r) const -> T {
+    if (l == r) return data[l];
+    size_t const layer = std::bit_width(l ^ r);
+    return func(data[layer * n + l], data[layer * n + r]);
+  }
+};
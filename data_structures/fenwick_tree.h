@@ -1,22 +1,46 @@
 /* Fenwick Tree
  * USAGE
  *  fenwick_tree<T> range_sum(n); // 0-indexed
+ *  fenwick_tree<T> range_sum(begin, end); // O(n) construction
  *  range_sum.query_range(l, r);
  *  range_sum.query_point(x);
- *  range_sum.update_range(l, r, v);
- *  range_sum.update_point(x, v);
+ *  range_sum.update_point(x, v); // adds v, same as update(x, v)
  *  range_sum.lower_bound(v);
  *    returns smallest r such that v <= sum_{0 <= i <= r} v_i
  *    returns n if no such r exists
+ *  range_sum.lower_bound_many(values, out); lower_bound for each value, written to out
+ *  range_sum.prefix_sum_many(positions, out); sum_{0 <= i <= r} v_i for each r
+ *    batches of 16 run in lockstep with prefetching, for large n (cache misses overlap)
+ *  range_fenwick_tree<T> range_add(n); or (begin, end)
+ *    query_range, query_point, update_point and lower_bound as above, plus
+ *  range_add.update_range(l, r, v); adds v to every value in [l, r]
+ *    lower_bound needs the values to be non-negative
+ *  concurrent_fenwick_tree<T> counts(n); integral T, update and queries from any thread
+ *  counts.merge(shard); adds a fenwick_tree<T> of the same size (eg. per-thread counts)
+ * NOTES
+ *  range_fenwick_tree keeps two trees over the differences d_i = v_i - v_{i-1}:
+ *  sum_{0 <= i <= r} v_i = (r + 1) * sum d_i - sum i * d_i
+ *  concurrent_fenwick_tree: updates are relaxed fetch_adds on each node, so an update is
+ *  not atomic as a whole. a query running concurrently with updates sees each of them
+ *  fully, partially or not at all, it is exact once the writers are done (eg. joined).
+ *  with non-negative updates, a prefix sum (query_range(0, r)) is between the sums before
+ *  and after them. a range [l, r] is the difference of two prefix sums, so it has no bound
+ *  merge adds the arrays node by node since the layout is linear, O(N) instead of N updates
  * TIME
+ *  O(N) construction
  *  O(logN) per query, update, lower_bound
  * STATUS
  *  untested: cf/1515i,104772h
  */
 #pragma once
 
+#include <algorithm>
+#include <atomic>
 #include <bit>
+#include <iterator>
+#include <ranges>
 #include <stdexcept>
+#include <type_traits>
 #include <vector>
 
 template <typename T>
@@ -26,8 +50,13 @@ struct fenwick_tree {
   fenwick_tree(int _n) : n(_n), logn(std::bit_width(unsigned(n)) - 1), data(n + 1) {}
   template <std::input_iterator input_it>
   fenwick_tree(input_it s, input_it t) : fenwick_tree(int(std::distance(s, t))) {
-    for (int i = 0; s != t; s++, i++) {
-      update(i, *s);
+    std::copy(s, t, data.begin() + 1);
+    build();
+  }
+  // data[i + 1] holds v_i, each node adds its sum to its parent (which comes later)
+  auto build() -> void {
+    for (int i = 1; i <= n; i++) {
+      if (int const j = i + (i & -i); j <= n) data[j] += data[i];
     }
   }
   auto query_point(int r) const -> T { return query_range(r, r); }
@@ -41,6 +70,7 @@ struct fenwick_tree {
     }
     return res;
   }
+  auto update_point(int i, T const& v) -> void { update(i, v); }
   auto update(int i, T const& v) -> void {
     if (i < 0 || n <= i) throw std::invalid_argument("update index out of bounds");
     for (i += 1; i <= n; i += i & -i) {
@@ -58,4 +88,165 @@ struct fenwick_tree {
     }
     return res;
   }
+  // branch-free step for lower_bound_many: always loads (clamped to n), the comparison only
+  // selects. a single query is faster with the branches, speculation overlaps its misses
+  auto _lower_bound_step(int& res, T& prefix, T const& v, int i) const -> void {
+    int const next = res + (1 << i);
+    T const value = data[std::min(next, n)];
+    bool const take = (next <= n) & (prefix + value < v);
+    res += int(take) << i;
+    prefix += take ? value : T(0);
+  }
+
+  // Batches, independent queries run in lockstep so that their cache misses overlap
+
+  static constexpr int batch_width = 16;
+  template <std::ranges::random_access_range value_range_t, typename output_it>
+  auto lower_bound_many(value_range_t const& values, output_it out) const -> output_it {
+    int const q = (int)std::ranges::size(values);
+    for (int first = 0; first < q; first += batch_width) {
+      int const width = std::min(batch_width, q - first);
+      int res[batch_width] = {};
+      T prefix[batch_width] = {};
+      for (int i = logn; i >= 0; i--) {
+        for (int k = 0; k < width; k++) {
+          _lower_bound_step(res[k], prefix[k], values[first + k], i);
+          if (i > 0) __builtin_prefetch(&data[std::min(res[k] + (1 << (i - 1)), n)]);
+        }
+      }
+      out = std::copy(res, res + width, out);
+    }
+    return out;
+  }
+  // prefix_sum_many(positions, out); _query(r) for each r, ie. sum_{0 <= i <= r} v_i
+  template <std::ranges::random_access_range position_range_t, typename output_it>
+  auto prefix_sum_many(position_range_t const& positions, output_it out) const -> output_it {
+    int const q = (int)std::ranges::size(positions);
+    for (int first = 0; first < q; first += batch_width) {
+      int const width = std::min(batch_width, q - first);
+      int index[batch_width];
+      T res[batch_width] = {};
+      for (int k = 0; k < width; k++) {
+        int const r = positions[first + k];
+        if (r >= n) throw std::invalid_argument("query index out of bounds");
+        index[k] = std::max(r, -1) + 1;
+        __builtin_prefetch(&data[index[k]]);
+      }
+      // data[0] is always 0, finished queries keep adding it
+      for (int i = 0; i <= logn; i++) {
+        for (int k = 0; k < width; k++) {
+          res[k] += data[index[k]];
+          index[k] &= index[k] - 1;
+        }
+      }
+      out = std::copy(res, res + width, out);
+    }
+    return out;
+  }
+};
+
+template <typename T>
+struct range_fenwick_tree {
+  int const n;
+  fenwick_tree<T> diff, weighted_diff;  // d_i and i * d_i
+  range_fenwick_tree(int _n) : n(_n), diff(n), weighted_diff(n) {}
+  template <std::input_iterator input_it>
+  range_fenwick_tree(input_it s, input_it t) : range_fenwick_tree(int(std::distance(s, t))) {
+    T prev = 0;
+    for (int i = 1; s != t; s++, i++) {
+      T const value = *s;
+      diff.data[i] = value - prev;
+      weighted_diff.data[i] = diff.data[i] * T(i - 1);
+      prev = value;
+    }
+    diff.build();
+    weighted_diff.build();
+  }
+  auto query_point(int x) const -> T { return query_range(x, x); }
+  auto query_range(int l, int r) const -> T { return _query(r) - _query(l - 1); }
+  auto _query(int r) const -> T {
+    if (r <= -1) return 0;
+    return diff._query(r) * T(r + 1) - weighted_diff._query(r);
+  }
+  auto update_point(int x, T const& v) -> void { update_range(x, x, v); }
+  auto update_range(int l, int r, T const& v) -> void {
+    if (r < l) return;  // empty range
+    if (l < 0 || n <= r) throw std::invalid_argument("update range out of bounds");
+    diff.update(l, v);
+    weighted_diff.update(l, v * T(l));
+    if (r + 1 < n) {
+      diff.update(r + 1, -v);
+      weighted_diff.update(r + 1, -v * T(r + 1));
+    }
+  }
+  // both trees are descended together, the prefix of length res + 2^i is checked from
+  // the partial sums of d_i and i * d_i
+  auto lower_bound(T const& v) const -> int {
+    int res = 0;
+    T prefix_diff = 0, prefix_weighted = 0;
+    for (int i = diff.logn; i >= 0; i--) {
+      int const next = res + (1 << i);
+      if (next > n) continue;
+      T const next_diff = prefix_diff + diff.data[next];
+      T const next_weighted = prefix_weighted + weighted_diff.data[next];
+      if (next_diff * T(next) - next_weighted < v) {
+        res = next;
+        prefix_diff = next_diff;
+        prefix_weighted = next_weighted;
+      }
+    }
+    return res;
+  }
+};
+
+template <typename T>
+  requires(std::is_integral_v<T>)
+struct concurrent_fenwick_tree {
+  static_assert(std::atomic_ref<T>::required_alignment <= alignof(T));
+  int const n, logn;
+  std::vector<T> data;
+  concurrent_fenwick_tree(int _n) : n(_n), logn(std::bit_width(unsigned(n)) - 1), data(n + 1) {}
+
+  auto load(int i) const -> T {
+    return std::atomic_ref<T>(const_cast<T&>(data[i])).load(std::memory_order_relaxed);
+  }
+  auto query_point(int r) const -> T { return query_range(r, r); }
+  auto query_range(int l, int r) const -> T { return _query(r) - _query(l - 1); }
+  auto _query(int r) const -> T {
+    if (r <= -1) return 0;
+    if (r >= n) throw std::invalid_argument("query index out of bounds");
+    T res = 0;
+    for (r += 1; r > 0; r -= r & -r) {
+      res += load(r);
+    }
+    return res;
+  }
+  auto update_point(int i, T const& v) -> void { update(i, v); }
+  auto update(int i, T const& v) -> void {
+    if (i < 0 || n <= i) throw std::invalid_argument("update index out of bounds");
+    for (i += 1; i <= n; i += i & -i) {
+      std::atomic_ref<T>(data[i]).fetch_add(v, std::memory_order_relaxed);
+    }
+  }
+  auto merge(fenwick_tree<T> const& shard) -> void {
+    if (shard.n != n) throw std::invalid_argument("merge size mismatch");
+    for (int i = 1; i <= n; i++) {
+      if (shard.data[i] != 0) {
+        std::atomic_ref<T>(data[i]).fetch_add(shard.data[i], std::memory_order_relaxed);
+      }
+    }
+  }
+  auto lower_bound(T const& v) const -> int {
+    int res = 0;
+    T prefix = 0;
+    for (int i = logn; i >= 0; i--) {
+      int const next = res + (1 << i);
+      if (next > n) continue;
+      if (T const value = load(next); prefix + value < v) {
+        res = next;
+        prefix += value;
+      }
+    }
+    return res;
+  }
 };
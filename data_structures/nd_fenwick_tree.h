@@ -0,0 +1,121 @@
+/* N-Dimensional Fenwick Tree
+ * USAGE
+ *  nd_fenwick_tree<T, 2> box_sum(n1, n2); // 0-indexed
+ *  nd_fenwick_tree<T, 2> box_sum(values); // values is an nd_array<T, 2>, O(N) construction
+ *  box_sum.update_point({x1, x2}, v); // adds v
+ *  box_sum.query_prefix({x1, x2}); // sum over [0, x1] x [0, x2]
+ *  box_sum.query_range({l1, l2}, {r1, r2}); // sum over [l1, r1] x [l2, r2]
+ *  box_sum.query_point({x1, x2});
+ * NOTES
+ *  one flat nd_array (each dimension padded by 1) instead of nested fenwick trees, the
+ *  bounds are checked once per call. query_range is inclusion-exclusion over 2^D prefixes
+ * TIME
+ *  O(N) construction
+ *  O(log^D N) per update, query_prefix; O(2^D log^D N) per query_range
+ * STATUS
+ *  untested
+ */
+#pragma once
+
+#include "utility/nd_array.h"
+
+#include <array>
+#include <bit>
+#include <stdexcept>
+#include <tuple>
+
+template <typename T, size_t D>
+  requires(D >= 1)
+struct nd_fenwick_tree {
+  using point_t = std::array<int, D>;
+  point_t n;
+  std::array<size_t, D> stride;
+  nd_array<T, D> data;
+
+  template <typename... Args>
+    requires(sizeof...(Args) == D)
+  nd_fenwick_tree(Args... ns) : n{int(ns)...}, data((size_t(ns) + 1)...) {
+    size_t s = 1;
+    for (int d = (int)D - 1; d >= 0; d--) {
+      stride[d] = s;
+      s *= n[d] + 1;
+    }
+  }
+  nd_fenwick_tree(nd_array<T, D> const& values)
+      : nd_fenwick_tree(std::make_from_tuple<nd_fenwick_tree>(values.dims())) {
+    for (size_t i = 0; i < values.size(); i++) {
+      size_t index = 0;
+      std::apply(
+          [&](auto... xs) {
+            size_t d = 0;
+            ((index += (xs + 1) * stride[d++]), ...);
+          },
+          values.from_index(i));
+      data[index] = values[i];
+    }
+    build();
+  }
+  // each dimension in turn, every node adds its sum to its parent (which comes later)
+  auto build() -> void {
+    for (size_t d = 0; d < D; d++) {
+      for (size_t index = 0; index < data.size(); index++) {
+        int const i = int(index / stride[d] % (n[d] + 1));
+        if (i == 0) continue;
+        if (int const j = i + (i & -i); j <= n[d]) {
+          data[index + (j - i) * stride[d]] += data[index];
+        }
+      }
+    }
+  }
+
+  auto update_point(point_t const& x, T const& v) -> void {
+    for (size_t d = 0; d < D; d++) {
+      if (x[d] < 0 || n[d] <= x[d]) throw std::invalid_argument("update index out of bounds");
+    }
+    _update<0>(0, x, v);
+  }
+  template <size_t d>
+  auto _update(size_t offset, point_t const& x, T const& v) -> void {
+    for (int i = x[d] + 1; i <= n[d]; i += i & -i) {
+      if constexpr (d + 1 == D) data[offset + i] += v;
+      else _update<d + 1>(offset + i * stride[d], x, v);
+    }
+  }
+
+  auto query_prefix(point_t const& x) const -> T {
+    for (size_t d = 0; d < D; d++) {
+      if (x[d] <= -1) return 0;
+      if (n[d] <= x[d]) throw std::invalid_argument("query index out of bounds");
+    }
+    return _query<0>(0, x);
+  }
+  auto query_point(point_t const& x) const -> T { return query_range(x, x); }
+  auto query_range(point_t const& l, point_t const& r) const -> T {
+    for (size_t d = 0; d < D; d++) {
+      if (r[d] < l[d]) return 0;
+      if (l[d] < 0 || n[d] <= r[d]) throw std::invalid_argument("query range out of bounds");
+    }
+    T res = 0;
+    for (size_t mask = 0; mask < (size_t(1) << D); mask++) {
+      point_t x;
+      bool empty = false;
+      for (size_t d = 0; d < D; d++) {
+        x[d] = (mask >> d & 1) ? l[d] - 1 : r[d];
+        empty |= (x[d] < 0);
+      }
+      if (empty) continue;
+      if (std::popcount(mask) & 1) res -= _query<0>(0, x);
+      else res += _query<0>(0, x);
+    }
+    return res;
+  }
+  template <size_t d>
+  auto _query(size_t offset, point_t const& x) const -> T {
+    T res = 0;
+    for (int i = x[d] + 1; i > 0; i -= i & -i) {
+      if constexpr (d + 1 == D) res += data[offset + i];
+      else res += _query<d + 1>(offset + i * stride[d], x);
+    }
+    return res;
+  }
+};
@@ -0,0 +1,115 @@
+/* Offline Segment Tree
+ * USAGE
+ *  offline_segment_tree<node_t> segtree(ranges); ranges = every [l, r] that will be updated
+ *    or queried (points as [x, x]), int64_t coordinates
+ *  offline_segment_tree<node_t, traits> segtree(ranges); traits for the inner segment_tree
+ *  node_t is the same as for segment_tree (data_structures/segment_tree.h), put, push and
+ *    accumulate get the number of coordinates in the segment as segment_length_t, push as
+ *    push(l, r, l_len, r_len) with the lengths of both children
+ * MEMBERS
+ *  update_range(l, r, value...);
+ *  update_point(x, value...);
+ *  query_range(l, r, ...);
+ *  query_point(x, ...);
+ *  search_left(l, r, ...); first coordinate of the leaf found, lim if not found
+ *  search_right(l, r, ...); same, from the right
+ *  lim; one past the largest registered coordinate
+ *  l, r and x must be registered, throws otherwise
+ *  All ranges are inclusive
+ * NOTES
+ *  the endpoints split the coordinates into elementary segments, each one is a leaf of a
+ *  dense WEIGHTED segment_tree whose weight is its number of coordinates
+ * TIME
+ *  O(QlogQ) construction, O(logQ) per operation
+ *  Q = |ranges|
+ * STATUS
+ *  untested
+ */
+#pragma once
+
+#include "data_structures/segment_tree.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <ranges>
+#include <stdexcept>
+#include <tuple>
+#include <vector>
+
+template <typename Node_t, segment_tree_traits traits = segment_tree_traits::NONE>
+struct offline_segment_tree {
+  using node_t = Node_t;
+  using coordinate_t = int64_t;
+  using tree_t = segment_tree<node_t, traits | traits.WEIGHTED>;
+  template <typename... Args>
+  using return_t = typename tree_t::template return_t<Args...>;
+
+  std::vector<coordinate_t> bounds;  // leaf k is [bounds[k], bounds[k + 1])
+  coordinate_t lim;
+  tree_t tree;
+
+  template <std::ranges::input_range range_list_t>
+  offline_segment_tree(range_list_t const& ranges)
+      : bounds(get_bounds(ranges)), lim(bounds.back()), tree((int)bounds.size() - 1) {
+    std::vector<coordinate_t> weights(bounds.size() - 1);
+    for (int k = 0; k + 1 < (int)bounds.size(); k++) weights[k] = bounds[k + 1] - bounds[k];
+    tree.set_weights(weights);
+  }
+  template <typename range_list_t>
+  static auto get_bounds(range_list_t const& ranges) -> std::vector<coordinate_t> {
+    std::vector<coordinate_t> res;
+    for (auto const& range : ranges) {
+      coordinate_t const l = std::get<0>(range), r = std::get<1>(range);
+      if (r < l) continue;
+      res.push_back(l);
+      res.push_back(r + 1);
+    }
+    if (res.empty()) res = {0, 1};
+    std::sort(res.begin(), res.end());
+    res.erase(std::unique(res.begin(), res.end()), res.end());
+    return res;
+  }
+
+  auto root() -> node_t& { return tree.root(); }
+  // index of the bound at x, which must be registered
+  auto index(coordinate_t x) const -> int {
+    auto const it = std::lower_bound(bounds.begin(), bounds.end(), x);
+    if (it == bounds.end() || *it != x) {
+      throw std::invalid_argument("coordinate was not registered");
+    }
+    return int(it - bounds.begin());
+  }
+
+  template <typename... Args>
+  auto update_range(coordinate_t l, coordinate_t r, Args const&... args) -> void {
+    if (r < l) return;  // empty range
+    tree.update_range(index(l), index(r + 1) - 1, args...);
+  }
+  template <typename... Args>
+  auto update_point(coordinate_t x, Args const&... args) -> void {
+    update_range(x, x, args...);
+  }
+
+  template <typename... Args>
+  auto query_range(coordinate_t l, coordinate_t r, Args const&... args) -> return_t<Args...> {
+    if (r < l) return tree.data[0].get(args...);
+    return tree.query_range(index(l), index(r + 1) - 1, args...);
+  }
+  template <typename... Args>
+  auto query_point(coordinate_t x, Args const&... args) -> return_t<Args...> {
+    return query_range(x, x, args...);
+  }
+
+  template <typename... Args>
+  auto search_left(coordinate_t l, coordinate_t r, Args... args) -> coordinate_t {
+    if (r < l) return lim;
+    int const k = tree.search_left(index(l), index(r + 1) - 1, args...);
+    return k == tree.lim ? lim : bounds[k];
+  }
+  template <typename... Args>
+  auto search_right(coordinate_t l, coordinate_t r, Args... args) -> coordinate_t {
+    if (r < l) return lim;
+    int const k = tree.search_right(index(l), index(r + 1) - 1, args...);
+    return k == tree.lim ? lim : bounds[k];
+  }
+};
@@ -1,12 +1,43 @@
 /* Range Minimum Query
  * USAGE
- *  data_structures/sparse_table.h
+ *  range_minimum_query<T, Compare> rmq(begin, end); data_structures/sparse_table.h
+ *  linear_range_minimum_query<T, Compare> rmq(begin, end); same queries, O(N) memory
+ *  auto val = rmq.query(l, r);
+ *    inclusive range [l, r]
+ *    assumes l <= r
+ *  range_argmin_query<T, Compare, ties> rmq(arr); query(l, r) returns the index of the minimum
+ *    ties is rmq_ties::LEFTMOST (default) or rmq_ties::RIGHTMOST
+ *    arr is not copied and must outlive rmq, at most 2^32 elements
+ * NOTES
+ *  linear_range_minimum_query splits the array into blocks of 64. inside a block, mask[i]
+ *  is the monotonic stack of [block start, i] as a bitmask, so the minimum of [l, i] is at
+ *  the lowest set bit >= l. a sparse_table over the block minima answers the middle part
+ *  memory is N values + N uint64_t + (N/64)log(N/64) values
+ *  range_argmin_query is a sparse_table of uint32_t indices whose Functional compares the
+ *  values they point to. the left argument of the Functional is never a larger index than
+ *  the right one (both while building and querying), so ties take a single comparison
+ * TIME
+ *  O(N) construction, O(1) query
+ *  N = |array|
+ * STATUS
+ *  untested
  */
 #pragma once
 
 #include "data_structures/sparse_table.h"
 
+#include <bit>
+#include <cstdint>
 #include <functional>
+#include <iterator>
+#include <limits>
+#include <ranges>
+#include <span>
+#include <stdexcept>
+#include <utility>
+#include <vector>
+
+enum class rmq_ties { LEFTMOST, RIGHTMOST };
 
 namespace range_minimum_query_details {
 template <typename Compare>
@@ -16,8 +47,85 @@ struct functional_compare {
     return Compare()(left, right) ? left : right;
   }
 };
+template <typename T, typename Compare, rmq_ties ties>
+struct index_compare {
+  std::span<T const> values;
+  // assumes i <= j
+  auto operator()(uint32_t i, uint32_t j) const -> uint32_t {
+    if constexpr (ties == rmq_ties::LEFTMOST) return Compare()(values[j], values[i]) ? j : i;
+    else return Compare()(values[i], values[j]) ? i : j;
+  }
+};
 }  // namespace range_minimum_query_details
 
 template <typename T, typename Compare = std::less<T>>
 using range_minimum_query =
     sparse_table<T, range_minimum_query_details::functional_compare<Compare>>;
+
+template <typename T, typename Compare = std::less<T>>
+struct linear_range_minimum_query {
+  static constexpr size_t block = 64;
+  using func_t = range_minimum_query_details::functional_compare<Compare>;
+  size_t const n;
+  std::vector<T> values;
+  std::vector<uint64_t> mask;
+  sparse_table<T, func_t> blocks;
+
+  template <std::input_iterator input_it>
+  linear_range_minimum_query(input_it s, input_it t)
+      : linear_range_minimum_query(std::vector<T>(s, t)) {}
+  linear_range_minimum_query(std::vector<T> _values)
+      : n(_values.size()), values(std::move(_values)), mask(n), blocks(build()) {}
+  // fills mask, returns the block minima
+  auto build() -> sparse_table<T, func_t> {
+    std::vector<T> minima;
+    minima.reserve((n + block - 1) / block);
+    uint64_t stack = 0;
+    for (size_t i = 0; i < n; i++) {
+      size_t const offset = i % block;
+      if (offset == 0) stack = 0;
+      while (stack && not Compare()(values[i - offset + top(stack)], values[i])) {
+        stack ^= uint64_t(1) << top(stack);
+      }
+      mask[i] = stack |= uint64_t(1) << offset;
+      if (offset == block - 1 || i == n - 1) {
+        minima.push_back(values[i - offset + std::countr_zero(stack)]);
+      }
+    }
+    return sparse_table<T, func_t>(minima.begin(), minima.end());
+  }
+  static auto top(uint64_t stack) -> size_t { return std::bit_width(stack) - 1; }
+
+  // l and r in the same block
+  auto _query_block(size_t l, size_t r) const -> T const& {
+    uint64_t const m = mask[r] & (~uint64_t(0) << (l % block));
+    return values[r - r % block + std::countr_zero(m)];
+  }
+  auto query(size_t l, size_t r) const -> T {
+    size_t const bl = l / block, br = r / block;
+    if (bl == br) return _query_block(l, r);
+    T res = func_t()(_query_block(l, bl * block + block - 1), _query_block(br * block, r));
+    if (bl + 1 < br) res = func_t()(res, blocks.query(bl + 1, br - 1));
+    return res;
+  }
+};
+
+template <typename T, typename Compare = std::less<T>, rmq_ties ties = rmq_ties::LEFTMOST>
+struct range_argmin_query {
+  using func_t = range_minimum_query_details::index_compare<T, Compare, ties>;
+  std::span<T const> values;
+  sparse_table<uint32_t, func_t> table;
+
+  template <std::ranges::contiguous_range range_t>
+  range_argmin_query(range_t const& arr) : values(arr), table(build(values)) {}
+  static auto build(std::span<T const> values) -> sparse_table<uint32_t, func_t> {
+    if (values.size() > std::numeric_limits<uint32_t>::max()) {
+      throw std::invalid_argument("range_argmin_query array is too large");
+    }
+    return sparse_table<uint32_t, func_t>(
+        std::views::iota(uint32_t(0), uint32_t(values.size())), func_t{values});
+  }
+
+  auto query(size_t l, size_t r) const -> size_t { return table.query(l, r); }
+  auto query_value(size_t l, size_t r) const -> T const& { return values[query(l, r)]; }
+};
@@ -2,6 +2,8 @@
  * USAGE
  *  segment_tree<node_t> segtree(n); initializes a segment tree with >= n leaves
  *  segment_tree<node_t> segtree(begin, end); initializes a segment tree with given values
+ *  segment_tree<node_t, SPARSE or PERSISTENT> segtree(n, capacity); preallocates nodes,
+ *    about 2 * q * log2(n) for q updates (nodes live in a chunked_vector, never copied)
  *  node_t is a class to be provided:
  *    STANDARD
  *      void put(args...); update at node
@@ -9,8 +11,12 @@
  *      static out_t merge(out_t const& l, out_t const& r, args...); merges the return values
  *      void pull(node_t const& l, node_t const& r); pulls values from children
  *      void push(node_t& l, node_t& r); pushes lazy to l and r
+ *        may take the segment_length_t of the node, or of l and r (l_len, r_len) which is
+ *        required for COMPACT and WEIGHTED (the children are not equally long)
  *      accumulate_t<type> accumulate(accumulate_t<type>, args...); for no-push lazy
  *        (accumulating the lazy values on the path from root to node on query)
+ *        may take a segment_length_t after the accumulator, which is the length of the
+ *        segment minus one (the sum of the weights for WEIGHTED)
  *    BINARY SEARCH
  *      bool contains(args&...); does the segment contain the value? update args if not
  *    BEATS
@@ -19,6 +25,11 @@
  *      conditions only apply to range updates
  *    PERSISTENT
  *      bool should_push(); to save some memory
+ *    SPARSE merge
+ *      void absorb(node_t const& o); combines two leaves at the same position
+ *    SPLIT
+ *      struct hot_t, cold_t; default constructible, the fields read by get/contains in hot_t
+ *      node_t(hot_t&, cold_t&); node_t is a view holding references to both parts
  * MEMBERS
  *  update_range(l, r, value...); value for range update
  *  query_range(l, r, ...); query with optional args
@@ -26,8 +37,52 @@
  *  query_point(x, ...); point query
  *  search_left(l, r, ...); search on the segtree, starting from the left
  *  search_right(l, r, ...); search on the segtree, starting from the right
+ *  query_ranges(ranges, out, ...); query_range for each [l, r] in ranges, written to out
+ *    in the same order, the queries run sorted by l (consecutive paths stay in the cache)
+ *  update_points(updates); update_point for each (x, value...) in updates, in order
+ *  apply_updates(updates); update_range for each (l, r, value...) in updates, in order
+ *    update batches share one walk from the root (no put_point for update_points, no
+ *    beats conditions for apply_updates)
+ *  query_range/query_point on a const segment_tree never write (lazy is pushed into
+ *    copies of the children), so they can run concurrently while there are no updates.
+ *    node_t::get and accumulate must be const. not for PERSISTENT
  *  returns segment_tree.lim if not found (ie. n in the constructor)
  *  All ranges are inclusive
+ * TRAITS (segment_tree_traits, at most one of SPARSE, PERSISTENT, ITERATIVE, COMPACT)
+ *  SPARSE; nodes created on demand, int64_t coordinates
+ *    make_root(); another empty tree sharing the nodes, update_*, query_*, search_* and
+ *      root() take it first (the default tree is root 1)
+ *    merge(a, b); merges tree b into a and returns the merged root, b's nodes are reused
+ *      O(common nodes), so O(n log n) for merging n points. no push or accumulate
+ *  PERSISTENT; update_* return a new version, other members take a version first
+ *    drop_version(v); keep_only(first, last); releases versions, other ids are unchanged
+ *    compact(); frees the nodes that are unreachable from the remaining versions
+ *  NO_CHECKS; skip bounds checks
+ *  ITERATIVE; bottom-up loops instead of recursion for update_point, query_range,
+ *    query_point, search_left, search_right. no push or accumulate
+ *  COMPACT; exactly 2n-1 nodes instead of padding to a power of two (preorder layout,
+ *    left child = i+1, right child = i + 2*(size of left segment)). segments are not
+ *    halved evenly, so push takes the lengths of both children if it needs lengths
+ *  ROLLBACK; every node overwritten by an update, push or pull is journaled first
+ *    (not with SPARSE or PERSISTENT, build() is not journaled)
+ *    checkpoint(); current position in the journal
+ *    rollback(checkpoint); restores the nodes as they were at checkpoint
+ *    the journal is only emptied by rollback, O(logN) nodes per update
+ *  SPLIT; hot_t and cold_t parts of the nodes are stored in separate arrays, so queries
+ *    that only read hot_t do not load cold_t (eg. the lazy tag). data[i] returns a
+ *    node_t view. segtree(begin, end) takes hot_t values. not with SPARSE, PERSISTENT,
+ *    COMPACT or ROLLBACK, no const queries
+ *  WEIGHTED; leaf x stands for weights[x] positions, put/push/accumulate get the sum of
+ *    the weights in the segment as segment_length_t
+ *    set_weights(weights); required before any update. not with SPARSE, PERSISTENT or
+ *    ITERATIVE, see data_structures/offline_segment_tree.h
+ *  INSTRUMENTED; counts visits, pushes, pulls, puts and allocations into segtree.stats,
+ *    see data_structures/segment_tree_stats.h (apply_updates stays on one thread)
+ * PARALLEL BUILD
+ *  define SEGMENT_TREE_PARALLEL_BUILD as the minimum length to build() on all threads
+ *  (normal layout only, eg. -D SEGMENT_TREE_PARALLEL_BUILD="1<<20")
+ *  define SEGMENT_TREE_PARALLEL_UPDATES as the minimum batch size for apply_updates to
+ *  hand the left child's updates to another thread (normal layout without ROLLBACK)
  * TIME
  *  O(logN) per query
  *  N = |array|
@@ -42,27 +97,41 @@
  */
 #pragma once
 
+#include "data_structures/chunked_vector.h"
+#include "data_structures/segment_tree_stats.h"
 #include "utility/traits.h"
 
+#include <algorithm>
 #include <bit>
+#include <numeric>
+#include <optional>
+#include <ranges>
+#include <span>
 #include <stdexcept>
+#include <tuple>
 #include <vector>
 
+#if defined(SEGMENT_TREE_PARALLEL_BUILD) || defined(SEGMENT_TREE_PARALLEL_UPDATES)
+#include "utility/parallel_for.h"
+
+#include <thread>
+#endif
+
 // clang-format off
 MAKE_TRAITS(segment_tree_traits,
-  (SPARSE, PERSISTENT, NO_CHECKS),
+  (SPARSE, PERSISTENT, NO_CHECKS, ITERATIVE, COMPACT, ROLLBACK, INSTRUMENTED, SPLIT, WEIGHTED),
 );
 // clang-format on
 
 struct segment_length_t {
   size_t value;
-  explicit segment_length_t(size_t v) : value(v) {}
-  explicit segment_length_t(int v) : value(v) {}
-  explicit segment_length_t(int64_t v) : value(v) {}
-  segment_length_t operator/(size_t c) const { return segment_length_t{value / c}; }
-  segment_length_t operator*(size_t c) const { return segment_length_t{value / c}; }
+  constexpr explicit segment_length_t(size_t v) : value(v) {}
+  constexpr explicit segment_length_t(int v) : value(v) {}
+  constexpr explicit segment_length_t(int64_t v) : value(v) {}
+  constexpr segment_length_t operator/(size_t c) const { return segment_length_t{value / c}; }
+  constexpr segment_length_t operator*(size_t c) const { return segment_length_t{value / c}; }
   template <typename T>
-  explicit operator T() const {
+  constexpr explicit operator T() const {
     return T(value);
   }
 };
@@ -84,6 +153,10 @@ struct segment_tree_children_t {
   int right = 0;
 };
 
+struct segment_tree_root_t {
+  int index;
+};
+
 template <typename node_t, segment_tree_traits traits>
 struct segment_tree_data {
   int lim, length;
@@ -109,6 +182,114 @@ struct segment_tree_data {
       { std::end(c) } -> std::input_iterator;
     })
   segment_tree_data(container const& c) : segment_tree_data(std::begin(c), std::end(c)) {}
+  auto build() -> void {
+    if constexpr (requires(node_t a, node_t b, node_t c) { a.pull(b, c); }) {
+#if defined(SEGMENT_TREE_PARALLEL_BUILD)
+      if (length >= (SEGMENT_TREE_PARALLEL_BUILD) and length >= 4) return _parallel_build();
+#endif
+      for (int i = length - 1; i > 0; i--) {
+        data[i].pull(data[get_left(i)], data[get_right(i)]);
+      }
+    }
+  }
+#if defined(SEGMENT_TREE_PARALLEL_BUILD)
+  // the subtrees rooted at [roots, 2 * roots) are built independently, then the top levels
+  auto _parallel_build() -> void {
+    int const roots = (int)std::min<size_t>(length / 2, std::bit_ceil(4 * parallel_threads()));
+    int const height = std::countr_zero((unsigned)(length / roots));
+    parallel_for(roots, 2 * roots, [&](size_t lo, size_t hi) {
+      for (int r = (int)lo; r < (int)hi; r++) {
+        for (int d = height - 1; d >= 0; d--) {
+          for (int i = (r + 1) << d; --i >= r << d;) {
+            data[i].pull(data[get_left(i)], data[get_right(i)]);
+          }
+        }
+      }
+    });
+    for (int i = roots - 1; i > 0; i--) {
+      data[i].pull(data[get_left(i)], data[get_right(i)]);
+    }
+  }
+#endif
+  static auto get_left(int i, auto...) -> int { return 2 * i; }
+  static auto get_right(int i, auto...) -> int { return 2 * i + 1; }
+};
+
+template <typename node_t, segment_tree_traits traits>
+  requires(bool((traits & traits.COMPACT)))
+struct segment_tree_data<node_t, traits> {
+  int lim, length;
+  std::vector<node_t> data;
+  auto operator[](int i) -> node_t& { return data[i]; }
+  auto root() -> node_t& { return data[1]; }
+
+  segment_tree_data(int n) : lim(n), length(std::max(n, 1)), data(2 * length) {}
+  segment_tree_data(int n, node_t init)
+      : lim(n), length(std::max(n, 1)), data(2 * length, init) {}
+  template <std::input_iterator input_it>
+  segment_tree_data(input_it s, input_it t) : segment_tree_data((int)std::distance(s, t)) {
+    if (lim > 0) _build(1, 0, length - 1, &s);
+  }
+  template <typename container>
+    requires(requires(container c) {
+      { std::begin(c) } -> std::input_iterator;
+      { std::end(c) } -> std::input_iterator;
+    })
+  segment_tree_data(container const& c) : segment_tree_data(std::begin(c), std::end(c)) {}
+  auto build() -> void { _build<node_t const*>(1, 0, length - 1, nullptr); }
+  // copies the leaves from *s (if given) in order, then pulls
+  template <typename input_it>
+  auto _build(int i, int seg_l, int seg_r, input_it* s) -> void {
+    if (seg_l == seg_r) {
+      if (s) data[i] = *(*s)++;
+      return;
+    }
+    int const mid = (seg_l + seg_r) / 2;
+    _build(get_left(i, seg_l, seg_r), seg_l, mid, s);
+    _build(get_right(i, seg_l, seg_r), mid + 1, seg_r, s);
+    if constexpr (requires(node_t a, node_t b, node_t c) { a.pull(b, c); }) {
+      data[i].pull(data[get_left(i, seg_l, seg_r)], data[get_right(i, seg_l, seg_r)]);
+    }
+  }
+  static auto get_left(int i, int, int) -> int { return i + 1; }
+  static auto get_right(int i, int seg_l, int seg_r) -> int {
+    return i + 2 * ((seg_r - seg_l) / 2 + 1);
+  }
+};
+
+template <typename node_t>
+struct segment_tree_split_storage {
+  std::vector<typename node_t::hot_t> hot;
+  std::vector<typename node_t::cold_t> cold;
+  segment_tree_split_storage(size_t n) : hot(n), cold(n) {}
+  auto operator[](int i) -> node_t { return node_t(hot[i], cold[i]); }
+  auto size() const -> size_t { return hot.size(); }
+};
+
+template <typename node_t, segment_tree_traits traits>
+  requires(bool((traits & traits.SPLIT)))
+struct segment_tree_data<node_t, traits> {
+  int lim, length;
+  segment_tree_split_storage<node_t> data;
+  auto operator[](int i) -> node_t { return data[i]; }
+  auto root() -> node_t { return data[1]; }
+
+  static auto get_power2(int n) -> int {
+    return 1 << (n <= 1 ? 0 : 32 - std::countl_zero((unsigned)n - 1));
+  }
+  segment_tree_data(int n) : lim(n), length(get_power2(lim)), data(2 * length) {}
+  template <std::input_iterator input_it>
+  segment_tree_data(input_it s, input_it t)
+      : lim((int)std::distance(s, t)), length(get_power2(lim)), data(2 * length) {
+    std::copy(s, t, data.hot.begin() + length);
+    build();
+  }
+  template <typename container>
+    requires(requires(container c) {
+      { std::begin(c) } -> std::input_iterator;
+      { std::end(c) } -> std::input_iterator;
+    })
+  segment_tree_data(container const& c) : segment_tree_data(std::begin(c), std::end(c)) {}
   auto build() -> void {
     if constexpr (requires(node_t a, node_t b, node_t c) { a.pull(b, c); }) {
       for (int i = length - 1; i > 0; i--) {
@@ -116,18 +297,20 @@ struct segment_tree_data {
       }
     }
   }
-  static auto get_left(int i) -> int { return 2 * i; }
-  static auto get_right(int i) -> int { return 2 * i + 1; }
+  static auto get_left(int i, auto...) -> int { return 2 * i; }
+  static auto get_right(int i, auto...) -> int { return 2 * i + 1; }
 };
 
 template <typename node_t, segment_tree_traits traits>
   requires(bool((traits & traits.SPARSE)))
 struct segment_tree_data<node_t, traits> {
   int64_t lim, length;
-  std::vector<node_t> data;
-  std::vector<segment_tree_children_t> children;
+  chunked_vector<node_t> data;
+  chunked_vector<segment_tree_children_t> children;
+  std::vector<int> free_nodes;
 
   auto root() -> node_t& { return data[1]; }
+  auto root(segment_tree_root_t r) -> node_t& { return data[r.index]; }
 
   static auto get_power2(int64_t n) -> int64_t {
     return 1ll << (n <= 1 ? 0 : 64 - std::countl_zero((uint64_t)n - 1));
@@ -139,27 +322,39 @@ struct segment_tree_data<node_t, traits> {
       children.reserve(capacity);
     }
   }
-  auto get_left(int i) const -> int { return children[i].left; }
-  auto get_right(int i) const -> int { return children[i].right; }
+  auto get_left(int i, auto...) const -> int { return children[i].left; }
+  auto get_right(int i, auto...) const -> int { return children[i].right; }
+  auto new_node() -> int {
+    if (not free_nodes.empty()) {
+      int const i = free_nodes.back();
+      free_nodes.pop_back();
+      data[i] = node_t();
+      children[i] = segment_tree_children_t();
+      return i;
+    }
+    data.emplace_back();
+    children.emplace_back();
+    return (int)data.size() - 1;
+  }
+  auto free_node(int i) -> void { free_nodes.push_back(i); }
+  auto make_root() -> segment_tree_root_t { return segment_tree_root_t{new_node()}; }
   auto make_left(int i) -> void {
     if (not get_left(i)) {
-      children[i].left = (int)data.size();
-      data.emplace_back();
-      children.emplace_back();
+      int const child = new_node();
+      children[i].left = child;
     }
   }
   auto make_right(int i) -> void {
     if (not get_right(i)) {
-      children[i].right = (int)data.size();
-      data.emplace_back();
-      children.emplace_back();
+      int const child = new_node();
+      children[i].right = child;
     }
   }
 };
 
 template <typename node_t>
 struct persistent_segment_tree_data {
-  std::vector<char> pushed;
+  chunked_vector<char> pushed;
   static constexpr bool has_should_push = false;
 };
 
@@ -174,9 +369,10 @@ template <typename node_t, segment_tree_traits traits>
 struct segment_tree_data<node_t, traits> : persistent_segment_tree_data<node_t> {
   using persistent_segment_tree_data<node_t>::has_should_push;
   int64_t lim, length;
-  std::vector<int> version_roots;
-  std::vector<node_t> data;
-  std::vector<segment_tree_children_t> children;
+  int first_version = 0;
+  std::vector<int> version_roots;  // -1 if dropped
+  chunked_vector<node_t> data;
+  chunked_vector<segment_tree_children_t> children;
 
   auto root(int version) -> node_t& { return data[get_root(version)]; }
 
@@ -197,9 +393,70 @@ struct segment_tree_data<node_t, traits> : persistent_segment_tree_data<node_t>
       this->pushed.resize(2);
     }
   }
-  auto get_root(int version) const -> int { return version_roots[version]; }
-  auto get_left(int i) const -> int { return children[i].left; }
-  auto get_right(int i) const -> int { return children[i].right; }
+  auto get_root(int version) const -> int { return version_roots[version - first_version]; }
+  auto has_version(int version) const -> bool {
+    return first_version <= version && version < first_version + (int)version_roots.size() &&
+           version_roots[version - first_version] != -1;
+  }
+  auto add_version(int root) -> int {
+    version_roots.push_back(root);
+    return first_version + (int)version_roots.size() - 1;
+  }
+
+  // Garbage collection, nodes are only freed by compact()
+
+  auto drop_version(int version) -> void {
+    if (not has_version(version)) throw std::invalid_argument("version does not exist");
+    version_roots[version - first_version] = -1;
+  }
+  auto keep_only(int first, int last) -> void {
+    for (int v = first_version; v < first_version + (int)version_roots.size(); v++) {
+      if (v < first || last < v) version_roots[v - first_version] = -1;
+    }
+  }
+  auto compact() -> void {
+    int dropped = 0;
+    while (dropped < (int)version_roots.size() && version_roots[dropped] == -1) dropped++;
+    version_roots.erase(version_roots.begin(), version_roots.begin() + dropped);
+    first_version += dropped;
+    // mark the nodes reachable from the live roots (0 and 1 are always kept)
+    std::vector<int> new_index(data.size(), -1), stack = {0, 1};
+    for (int root : version_roots) {
+      if (root != -1) stack.push_back(root);
+    }
+    while (not stack.empty()) {
+      int const i = stack.back();
+      stack.pop_back();
+      if (new_index[i] != -1) continue;
+      new_index[i] = 0;
+      if (children[i].left) stack.push_back(children[i].left);
+      if (children[i].right) stack.push_back(children[i].right);
+    }
+    // new_index[i] <= i, so the nodes can be moved down in place
+    int size = 0;
+    for (int i = 0; i < (int)data.size(); i++) {
+      if (new_index[i] == -1) continue;
+      new_index[i] = size;
+      if (i != size) {
+        data[size] = std::move(data[i]);
+        children[size] = children[i];
+        if constexpr (not has_should_push) this->pushed[size] = this->pushed[i];
+      }
+      size++;
+    }
+    data.resize(size);
+    children.resize(size);
+    if constexpr (not has_should_push) this->pushed.resize(size);
+    for (int i = 0; i < size; i++) {
+      children[i].left = new_index[children[i].left];
+      children[i].right = new_index[children[i].right];
+    }
+    for (int& root : version_roots) {
+      if (root != -1) root = new_index[root];
+    }
+  }
+  auto get_left(int i, auto...) const -> int { return children[i].left; }
+  auto get_right(int i, auto...) const -> int { return children[i].right; }
   template <typename... Args>
   auto make_node(int i) -> int {
     data.emplace_back(data[i]);
@@ -223,6 +480,22 @@ struct segment_tree_data<node_t, traits> : persistent_segment_tree_data<node_t>
   }
 };
 
+template <typename node_t, bool journaled>
+struct segment_tree_journal {};
+
+template <bool weighted>
+struct segment_tree_weights {};
+
+template <>
+struct segment_tree_weights<true> {
+  std::vector<int64_t> weight_prefix;  // sum of the weights of the leaves before x
+};
+
+template <typename node_t>
+struct segment_tree_journal<node_t, true> {
+  std::vector<std::pair<int, node_t>> journal;  // (index, overwritten node)
+};
+
 namespace segment_tree_details {
 template <typename node_t, typename... Args>
 struct return_getter {
@@ -233,14 +506,44 @@ template <typename node_t, typename... Args>
 struct return_getter<node_t, Args...> {
   using type = decltype(std::declval<node_t>().get(std::declval<Args>()...));
 };
+template <typename node_t, typename... Args>
+struct has_accumulate : std::false_type {};
+template <typename node_t, typename acc_t, typename... Args>
+  requires(has_segment_accumulate<node_t, acc_t, Args...>)
+struct has_accumulate<node_t, acc_t, Args...> : std::true_type {};
+// whether node_t has any member named accumulate (the lookup in accumulate_lookup is then
+// ambiguous), whatever its arguments
+struct accumulate_probe {
+  void accumulate();
+};
+template <typename node_t>
+struct accumulate_lookup : node_t, accumulate_probe {};
+template <typename node_t>
+constexpr bool has_accumulate_member = not requires { &accumulate_lookup<node_t>::accumulate; };
 }  // namespace segment_tree_details
 
 template <typename Node_t, segment_tree_traits traits = segment_tree_traits::NONE>
-  requires(traits.count(traits.SPARSE | traits.PERSISTENT) <= 1)
-struct segment_tree : segment_tree_data<Node_t, traits> {
+  requires(
+      traits.count(traits.SPARSE | traits.PERSISTENT | traits.ITERATIVE | traits.COMPACT) <=
+          1 and
+      traits.count(traits.SPARSE | traits.PERSISTENT | traits.ROLLBACK) <= 1 and
+      traits.count(traits.SPARSE | traits.PERSISTENT | traits.ITERATIVE | traits.WEIGHTED) <=
+          1 and
+      (not(traits & traits.SPLIT) or
+       not(traits & (traits.SPARSE | traits.PERSISTENT | traits.COMPACT | traits.ROLLBACK))))
+struct segment_tree : segment_tree_data<Node_t, traits>,
+                      segment_tree_journal<Node_t, bool(traits & traits.ROLLBACK)>,
+                      segment_tree_counters<bool(traits & traits.INSTRUMENTED)>,
+                      segment_tree_weights<bool(traits & traits.WEIGHTED)> {
   static constexpr bool sparse = bool(traits & traits.SPARSE);
   static constexpr bool persistent = bool(traits & traits.PERSISTENT);
   static constexpr bool normal = not sparse and not persistent;
+  static constexpr bool iterative = bool(traits & traits.ITERATIVE);
+  static constexpr bool journaled = bool(traits & traits.ROLLBACK);
+  static constexpr bool instrumented = bool(traits & traits.INSTRUMENTED);
+  static constexpr bool split_nodes = bool(traits & traits.SPLIT);
+  static constexpr bool weighted = bool(traits & traits.WEIGHTED);
+  static constexpr bool compact_layout = bool(traits & traits.COMPACT);
   static constexpr bool check_bounds = not(traits & traits.NO_CHECKS);
   using coordinate_t = std::conditional_t<normal, int, int64_t>;
 
@@ -261,7 +564,20 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
       requires(node_t nd, node_t& nd_ref) { nd.push(nd_ref, nd_ref); };
   static constexpr bool has_push_with_length =
       requires(node_t nd, node_t& nd_ref, segment_length_t sl) { nd.push(nd_ref, nd_ref, sl); };
-  static_assert(has_push_no_length + has_push_with_length <= 1);
+  static constexpr bool has_push_with_child_lengths =
+      requires(node_t nd, node_t& nd_ref, segment_length_t sl) {
+        nd.push(nd_ref, nd_ref, sl, sl);
+      };
+  static_assert(has_push_no_length + has_push_with_length + has_push_with_child_lengths <= 1);
+  static constexpr bool has_push =
+      has_push_no_length or has_push_with_length or has_push_with_child_lengths;
+  static_assert(
+      not weighted or not has_push_with_length,
+      "WEIGHTED children are not equally long, use push(l, r, left_length, right_length)");
+  static_assert(
+      not compact_layout or not has_push_with_length,
+      "COMPACT children are not equally long, use push(l, r, left_length, right_length)");
+  static_assert(not iterative or not has_push);
 
   static constexpr bool has_pull =
       requires(node_t nd, node_t const& nd_cref) { nd.pull(nd_cref, nd_cref); };
@@ -271,14 +587,205 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
         node_t::merge(ret, ret, args...);
       } && std::is_same_v<node_t, return_t<Args...>>;
 
+  template <typename... Args>
+  static constexpr bool has_accumulate =
+      segment_tree_details::has_accumulate<node_t, Args...>::value;
+
+  template <typename... Args>
+  static auto _merge(
+      return_t<Args...> const& left, return_t<Args...> const& right, Args const&... args)
+      -> return_t<Args...> {
+    if constexpr (use_pull_as_merge<Args...>) return node_t().pull(left, right);
+    else return node_t::merge(left, right, args...);
+  }
+
   template <typename... Args>
   segment_tree(Args&&... args)
       : segment_tree_data<Node_t, traits>(std::forward<Args>(args)...) {}
 
-  // Updates
+  // Multiple roots (SPARSE)
 
   template <typename... Args>
-  auto push(int i, Args const&... args) -> void {
+  auto update_range(
+      segment_tree_root_t root, coordinate_t l, coordinate_t r, Args const&... args)
+      -> void
+    requires(sparse)
+  {
+    if constexpr (check_bounds) {
+      if (r < l) return;  // empty range
+      if (l < 0 || lim <= r) throw std::invalid_argument("update range out of bounds");
+    }
+    _update_range(l, r, root.index, 0, length - 1, args...);
+  }
+  template <typename... Args>
+  auto update_point(segment_tree_root_t root, coordinate_t x, Args const&... args) -> void
+    requires(sparse)
+  {
+    if constexpr (check_bounds) {
+      if (x < 0 || lim <= x) throw std::invalid_argument("update_point index out of bounds");
+    }
+    _update_point(x, root.index, 0, length - 1, args...);
+  }
+  template <typename... Args>
+  auto query_range(
+      segment_tree_root_t root, coordinate_t l, coordinate_t r, Args const&... args)
+      -> return_t<Args...>
+    requires(requires(node_t nd) { nd.get(args...); } and sparse)
+  {
+    if constexpr (check_bounds) {
+      if (r < l) return data[0].get(args...);
+      if (l < 0 || lim <= r) throw std::invalid_argument("query range out of bounds");
+    }
+    return _query_range(l, r, root.index, 0, length - 1, args...);
+  }
+  template <typename... Args>
+  auto query_point(segment_tree_root_t root, coordinate_t x, Args const&... args)
+      -> return_t<Args...>
+    requires(requires(node_t nd) { nd.get(args...); } and sparse)
+  {
+    if constexpr (check_bounds) {
+      if (x < 0 || lim <= x) throw std::invalid_argument("query_point index out of bounds");
+    }
+    return _query_point(x, root.index, 0, length - 1, args...);
+  }
+  template <typename... Args>
+  auto search_left(segment_tree_root_t root, coordinate_t l, coordinate_t r, Args... args)
+      -> coordinate_t
+    requires(sparse)
+  {
+    if constexpr (check_bounds) {
+      if (r < l) return lim;
+      if (l < 0 || lim <= r) throw std::invalid_argument("search_left out of bounds");
+    }
+    return _search_left(l, r, root.index, 0, length - 1, args...);
+  }
+  template <typename... Args>
+  auto search_right(segment_tree_root_t root, coordinate_t l, coordinate_t r, Args... args)
+      -> coordinate_t
+    requires(sparse)
+  {
+    if constexpr (check_bounds) {
+      if (r < l) return lim;
+      if (l < 0 || lim <= r) throw std::invalid_argument("search_right out of bounds");
+    }
+    return _search_right(l, r, root.index, 0, length - 1, args...);
+  }
+
+  auto merge(segment_tree_root_t a, segment_tree_root_t b) -> segment_tree_root_t
+    requires(sparse)
+  {
+    static_assert(not has_push, "merge does not support push");
+    static_assert(
+        not segment_tree_details::has_accumulate_member<node_t>,
+        "merge does not support accumulate");
+    return segment_tree_root_t{_merge_trees(a.index, b.index, 0, length - 1)};
+  }
+  auto _merge_trees(int a, int b, coordinate_t const seg_l, coordinate_t const seg_r) -> int {
+    if (not b) return a;
+    if (not a) return b;
+    visit(seg_l, seg_r);
+    if (seg_l == seg_r) {
+      data[a].absorb(data[b]);
+    } else {
+      coordinate_t const mid = (seg_l + seg_r) / 2;
+      int const left = _merge_trees(get_left(a), get_left(b), seg_l, mid);
+      int const right = _merge_trees(get_right(a), get_right(b), mid + 1, seg_r);
+      this->children[a] = segment_tree_children_t{left, right};
+      if constexpr (has_pull) pull(a, seg_l, seg_r);
+    }
+    this->free_node(b);
+    return a;
+  }
+
+  // Rollback
+
+  auto checkpoint() const -> size_t
+    requires(journaled)
+  {
+    return this->journal.size();
+  }
+  auto rollback(size_t checkpoint) -> void
+    requires(journaled)
+  {
+    if constexpr (check_bounds) {
+      if (this->journal.size() < checkpoint) {
+        throw std::invalid_argument("checkpoint does not exist");
+      }
+    }
+    while (this->journal.size() > checkpoint) {
+      auto& [i, node] = this->journal.back();
+      data[i] = std::move(node);
+      this->journal.pop_back();
+    }
+  }
+  // journals data[i] before it is overwritten
+  auto save(int i) -> void {
+    if constexpr (journaled) this->journal.emplace_back(i, data[i]);
+  }
+
+  // Weights
+
+  template <std::ranges::input_range weight_range_t>
+  auto set_weights(weight_range_t const& weights) -> void
+    requires(weighted)
+  {
+    auto& prefix = this->weight_prefix;
+    prefix.assign(1, 0);
+    for (auto const& w : weights) prefix.push_back(prefix.back() + (int64_t)w);
+    if constexpr (check_bounds) {
+      if ((int)prefix.size() != lim + 1) {
+        throw std::invalid_argument("number of weights does not match the size");
+      }
+    }
+    prefix.resize(length + 1, prefix.back());
+  }
+  auto segment_length(coordinate_t const seg_l, coordinate_t const seg_r) const
+      -> segment_length_t {
+    if constexpr (weighted) {
+      return segment_length_t{this->weight_prefix[seg_r + 1] - this->weight_prefix[seg_l]};
+    } else {
+      return segment_length_t{seg_r - seg_l + 1};
+    }
+  }
+  // accumulate gets one less than the length, except for WEIGHTED
+  auto accumulate_length(coordinate_t const seg_l, coordinate_t const seg_r) const
+      -> segment_length_t {
+    if constexpr (weighted) return segment_length(seg_l, seg_r);
+    else return segment_length_t{seg_r - seg_l};
+  }
+
+  // Instrumentation
+
+  auto visit(coordinate_t const seg_l, coordinate_t const seg_r) -> void {
+    if constexpr (instrumented) {
+      this->stats.visits++;
+      int const depth = int(
+          std::bit_width((uint64_t)length - 1) - std::bit_width((uint64_t)(seg_r - seg_l)));
+      this->stats.max_depth = std::max(this->stats.max_depth, depth);
+    }
+  }
+  auto make_left(int i) -> void
+    requires(sparse)
+  {
+    if constexpr (instrumented) this->stats.allocations += not get_left(i);
+    segment_tree_data<Node_t, traits>::make_left(i);
+  }
+  auto make_right(int i) -> void
+    requires(sparse)
+  {
+    if constexpr (instrumented) this->stats.allocations += not get_right(i);
+    segment_tree_data<Node_t, traits>::make_right(i);
+  }
+  auto make_node(int i) -> int
+    requires(persistent)
+  {
+    if constexpr (instrumented) this->stats.allocations++;
+    return segment_tree_data<Node_t, traits>::make_node(i);
+  }
+
+  // Updates
+
+  auto push(int i, coordinate_t const seg_l, coordinate_t const seg_r) -> void {
     if constexpr (sparse) {
       this->make_left(i);
       this->make_right(i);
@@ -288,7 +795,21 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
       this->children[i].left = this->make_node(get_left(i));
       this->children[i].right = this->make_node(get_right(i));
     }
-    data[i].push(data[get_left(i)], data[get_right(i)], args...);
+    if constexpr (instrumented) this->stats.pushes++;
+    if constexpr (journaled) {
+      save(i);
+      save(get_left(i, seg_l, seg_r));
+      save(get_right(i, seg_l, seg_r));
+    }
+    _push_node(
+        data[i], data[get_left(i, seg_l, seg_r)], data[get_right(i, seg_l, seg_r)], seg_l,
+        seg_r);
+  }
+
+  auto pull(int i, coordinate_t const seg_l, coordinate_t const seg_r) -> void {
+    if constexpr (instrumented) this->stats.pulls++;
+    save(i);
+    data[i].pull(data[get_left(i, seg_l, seg_r)], data[get_right(i, seg_l, seg_r)]);
   }
 
   template <typename... Args>
@@ -296,6 +817,8 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
       nd.put(sl, args...);
     })
   auto put(int i, Args const&... args) -> update_return_t {
+    if constexpr (instrumented) this->stats.puts++;
+    save(i);
     data[i].put(args...);
     if constexpr (persistent) return i;
   }
@@ -305,6 +828,8 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
       nd.put_point(sl, args...);
     })
   auto put_point(int i, Args const&... args) -> update_return_t {
+    if constexpr (instrumented) this->stats.puts++;
+    save(i);
     data[i].put_point(args...);
     if constexpr (persistent) return i;
   }
@@ -333,13 +858,12 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
     if constexpr (check_bounds) {
       if (r < l) return version;  // empty range
       if (l < 0 || lim <= r) throw std::invalid_argument("update range out of bounds");
-      if (version >= (int)this->version_roots.size()) {
+      if (not this->has_version(version)) {
         throw std::invalid_argument("version does not exist");
       }
     }
-    this->version_roots.push_back(
+    return this->add_version(
         _update_range(l, r, this->get_root(version), 0, length - 1, args...));
-    return (int)this->version_roots.size() - 1;
   }
   template <typename... Args>
     requires(
@@ -350,51 +874,55 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
   auto _update_range(
       coordinate_t const l, coordinate_t const r, int i, coordinate_t const seg_l,
       coordinate_t const seg_r, Args const&... args) -> update_return_t {
+    visit(seg_l, seg_r);
     if constexpr (requires { data[i].update_break_cond(args...); }) {
-      if (data[i].update_break_cond(args...)) return;
+      if (data[i].update_break_cond(args...)) {
+        if constexpr (instrumented) this->stats.breaks++;
+        return;
+      }
     }
     if constexpr (not requires { data[i].update_put_cond(args...); }) {
       if (l <= seg_l && seg_r <= r) {
         if constexpr (persistent) i = this->make_node(i);
         if constexpr (requires { data[i].put(args...); }) return put(i, args...);
-        else return put(i, segment_length_t{seg_r - seg_l + 1}, args...);
+        else return put(i, segment_length(seg_l, seg_r), args...);
       }
     } else {  // can't be persistent
       if (l <= seg_l && seg_r <= r && data[i].update_put_cond(args...)) {
         if constexpr (requires { data[i].put(args...); }) return put(i, args...);
-        else return put(i, segment_length_t{seg_r - seg_l + 1}, args...);
+        else return put(i, segment_length(seg_l, seg_r), args...);
       }
       if constexpr (check_bounds) {
-        if (i >= length) {
+        if (seg_l == seg_r) {
           throw std::invalid_argument(
               "update_put_cond/update_break_cond is incorrect, "
               "trying to descend past a leaf");
         }
       }
     }
-    if constexpr (has_push_with_length) push(i, segment_length_t{seg_r - seg_l + 1});
-    if constexpr (has_push_no_length) push(i);
+    if constexpr (has_push) push(i, seg_l, seg_r);
     int const old_i = i;
     if constexpr (persistent) i = this->make_node(i);
     coordinate_t const mid = (seg_l + seg_r) / 2;
     if (l <= mid) {
       if constexpr (persistent) {
-        this->children[i].left = _update_range(l, r, get_left(old_i), seg_l, mid, args...);
+        this->children[i].left =
+            _update_range(l, r, get_left(old_i, seg_l, seg_r), seg_l, mid, args...);
       } else {
         if constexpr (sparse) this->make_left(i);
-        _update_range(l, r, get_left(i), seg_l, mid, args...);
+        _update_range(l, r, get_left(i, seg_l, seg_r), seg_l, mid, args...);
       }
     }
     if (mid < r) {
       if constexpr (persistent) {
         this->children[i].right =
-            _update_range(l, r, get_right(old_i), mid + 1, seg_r, args...);
+            _update_range(l, r, get_right(old_i, seg_l, seg_r), mid + 1, seg_r, args...);
       } else {
         if constexpr (sparse) this->make_right(i);
-        _update_range(l, r, get_right(i), mid + 1, seg_r, args...);
+        _update_range(l, r, get_right(i, seg_l, seg_r), mid + 1, seg_r, args...);
       }
     }
-    if constexpr (has_pull) data[i].pull(data[get_left(i)], data[get_right(i)]);
+    if constexpr (has_pull) pull(i, seg_l, seg_r);
     if constexpr (persistent) return i;
   }
 
@@ -405,7 +933,8 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
     if constexpr (check_bounds) {
       if (x < 0 || lim <= x) throw std::invalid_argument("update_point index out of bounds");
     }
-    return _update_point(x, 1, 0, length - 1, args...);
+    if constexpr (iterative) return _iterative_update_point(x, args...);
+    else return _update_point(x, 1, 0, length - 1, args...);
   }
   template <typename... Args>
   auto update_point(int version, coordinate_t x, Args const&... args) -> update_return_t
@@ -413,55 +942,55 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
   {
     if constexpr (check_bounds) {
       if (x < 0 || lim <= x) throw std::invalid_argument("update_point index out of bounds");
-      if (version >= (int)this->version_roots.size()) {
+      if (not this->has_version(version)) {
         throw std::invalid_argument("version does not exist");
       }
     }
-    this->version_roots.push_back(
-        _update_point(x, this->get_root(version), 0, length - 1, args...));
-    return (int)this->version_roots.size() - 1;
+    return this->add_version(_update_point(x, this->get_root(version), 0, length - 1, args...));
   }
   template <typename... Args>
   auto _update_point(
       coordinate_t const x, int i, coordinate_t const seg_l, coordinate_t const seg_r,
       Args const&... args) -> update_return_t {
+    visit(seg_l, seg_r);
     if (seg_l == seg_r) {
       if constexpr (persistent) i = this->make_node(i);
       if constexpr (requires { data[i].put(args...); }) put(i, args...);
-      else put(i, segment_length_t{seg_r - seg_l + 1}, args...);
+      else put(i, segment_length(seg_l, seg_r), args...);
       if constexpr (requires { data[i].put_point(args...); }) {
         put_point(i, args...);
       } else if constexpr (requires(segment_length_t sl) { data[i].put_point(sl, args...); }) {
-        put_point(i, segment_length_t{seg_r - seg_l + 1}, args...);
+        put_point(i, segment_length(seg_l, seg_r), args...);
       }
       if constexpr (persistent) return i;
       else return;
     }
-    if constexpr (has_push_with_length) push(i, segment_length_t{seg_r - seg_l + 1});
-    if constexpr (has_push_no_length) push(i);
+    if constexpr (has_push) push(i, seg_l, seg_r);
     int const old_i = i;
     if constexpr (persistent) i = this->make_node(i);
     coordinate_t const mid = (seg_l + seg_r) / 2;
     if (x <= mid) {
       if constexpr (persistent) {
-        this->children[i].left = _update_point(x, get_left(old_i), seg_l, mid, args...);
+        this->children[i].left =
+            _update_point(x, get_left(old_i, seg_l, seg_r), seg_l, mid, args...);
       } else {
         if constexpr (sparse) this->make_left(i);
-        _update_point(x, get_left(i), seg_l, mid, args...);
+        _update_point(x, get_left(i, seg_l, seg_r), seg_l, mid, args...);
       }
     } else {
       if constexpr (persistent) {
-        this->children[i].right = _update_point(x, get_right(old_i), mid + 1, seg_r, args...);
+        this->children[i].right =
+            _update_point(x, get_right(old_i, seg_l, seg_r), mid + 1, seg_r, args...);
       } else {
         if constexpr (sparse) this->make_right(i);
-        _update_point(x, get_right(i), mid + 1, seg_r, args...);
+        _update_point(x, get_right(i, seg_l, seg_r), mid + 1, seg_r, args...);
       }
     }
-    if constexpr (has_pull) data[i].pull(data[get_left(i)], data[get_right(i)]);
+    if constexpr (has_pull) pull(i, seg_l, seg_r);
     if constexpr (requires { data[i].put_point(args...); }) {
       put_point(i, args...);
     } else if constexpr (requires(segment_length_t sl) { data[i].put_point(sl, args...); }) {
-      put_point(i, segment_length_t{seg_r - seg_l + 1}, args...);
+      put_point(i, segment_length(seg_l, seg_r), args...);
     }
     if constexpr (persistent) return i;
   }
@@ -476,7 +1005,8 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
       if (r < l) return data[0].get(args...);
       if (l < 0 || lim <= r) throw std::invalid_argument("query range out of bounds");
     }
-    return _query_range(l, r, 1, 0, length - 1, args...);
+    if constexpr (iterative) return _iterative_query_range(l, r, args...);
+    else return _query_range(l, r, 1, 0, length - 1, args...);
   }
   template <typename... Args>
   auto query_range(int version, coordinate_t l, coordinate_t r, Args const&... args)
@@ -486,7 +1016,7 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
     if constexpr (check_bounds) {
       if (r < l) return data[0].get(args...);
       if (l < 0 || lim <= r) throw std::invalid_argument("query range out of bounds");
-      if (version >= (int)this->version_roots.size()) {
+      if (not this->has_version(version)) {
         throw std::invalid_argument("version does not exist");
       }
     }
@@ -503,7 +1033,7 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
       return _query_range_impl(l, r, i, seg_l, seg_r, accumulate(i, acc, args...), args...);
     } else {
       return _query_range_impl(
-          l, r, i, seg_l, seg_r, accumulate(i, acc, segment_length_t{seg_r - seg_l}, args...),
+          l, r, i, seg_l, seg_r, accumulate(i, acc, accumulate_length(seg_l, seg_r), args...),
           args...);
     }
   }
@@ -517,29 +1047,33 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
   auto _query_range_impl(
       coordinate_t const l, coordinate_t const r, int const i, coordinate_t const seg_l,
       coordinate_t const seg_r, Args const&... args) -> return_t<Args...> {
+    visit(seg_l, seg_r);
     if (l <= seg_l && seg_r <= r) return data[i].get(args...);
-    if constexpr (has_push_with_length) push(i, segment_length_t{seg_r - seg_l + 1});
-    if constexpr (has_push_no_length) push(i);
+    if constexpr (has_push) push(i, seg_l, seg_r);
     coordinate_t const mid = (seg_l + seg_r) / 2;
     bool go_left = (l <= mid);
     bool go_right = (mid < r);
     if constexpr (sparse or persistent) {
-      go_left &= (get_left(i) != 0);
-      go_right &= (get_right(i) != 0);
+      go_left &= (get_left(i, seg_l, seg_r) != 0);
+      go_right &= (get_right(i, seg_l, seg_r) != 0);
       if (not go_left and not go_right) {
         return data[0].get(args...);  // this can't happen right?
       }
     }
-    if (not go_right) return _query_range(l, r, get_left(i), seg_l, mid, args...);
-    if (not go_left) return _query_range(l, r, get_right(i), mid + 1, seg_r, args...);
+    if (not go_right) {
+      return _query_range(l, r, get_left(i, seg_l, seg_r), seg_l, mid, args...);
+    }
+    if (not go_left) {
+      return _query_range(l, r, get_right(i, seg_l, seg_r), mid + 1, seg_r, args...);
+    }
     if constexpr (use_pull_as_merge<Args...>) {
       return node_t().pull(
-          _query_range(l, r, get_left(i), seg_l, mid, args...),
-          _query_range(l, r, get_right(i), mid + 1, seg_r, args...));
+          _query_range(l, r, get_left(i, seg_l, seg_r), seg_l, mid, args...),
+          _query_range(l, r, get_right(i, seg_l, seg_r), mid + 1, seg_r, args...));
     } else {
       return node_t::merge(
-          _query_range(l, r, get_left(i), seg_l, mid, args...),
-          _query_range(l, r, get_right(i), mid + 1, seg_r, args...), args...);
+          _query_range(l, r, get_left(i, seg_l, seg_r), seg_l, mid, args...),
+          _query_range(l, r, get_right(i, seg_l, seg_r), mid + 1, seg_r, args...), args...);
     }
   }
 
@@ -550,7 +1084,8 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
     if constexpr (check_bounds) {
       if (x < 0 || lim <= x) throw std::invalid_argument("query_point index out of bounds");
     }
-    return _query_point(x, 1, 0, length - 1, args...);
+    if constexpr (iterative) return data[length + x].get(args...);
+    else return _query_point(x, 1, 0, length - 1, args...);
   }
   template <typename... Args>
   auto query_point(int version, coordinate_t x, Args const&... args) -> return_t<Args...>
@@ -558,7 +1093,7 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
   {
     if constexpr (check_bounds) {
       if (x < 0 || lim <= x) throw std::invalid_argument("query_point index out of bounds");
-      if (version >= (int)this->version_roots.size()) {
+      if (not this->has_version(version)) {
         throw std::invalid_argument("version does not exist");
       }
     }
@@ -574,7 +1109,7 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
       return _query_point_impl(x, i, seg_l, seg_r, accumulate(i, acc, args...), args...);
     } else {
       return _query_point_impl(
-          x, i, seg_l, seg_r, accumulate(i, acc, segment_length_t{seg_r - seg_l}, args...),
+          x, i, seg_l, seg_r, accumulate(i, acc, accumulate_length(seg_l, seg_r), args...),
           args...);
     }
   }
@@ -588,23 +1123,383 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
   auto _query_point_impl(
       coordinate_t const x, int const i, coordinate_t const seg_l, coordinate_t const seg_r,
       Args const&... args) -> return_t<Args...> {
+    visit(seg_l, seg_r);
     if (seg_l == seg_r) return data[i].get(args...);
-    if constexpr (has_push_with_length) push(i, segment_length_t{seg_r - seg_l + 1});
-    if constexpr (has_push_no_length) push(i);
+    if constexpr (has_push) push(i, seg_l, seg_r);
     coordinate_t const mid = (seg_l + seg_r) / 2;
     if (x <= mid) {
       if constexpr (sparse or persistent) {
-        if (not get_left(i)) return data[0].get(args...);
+        if (not get_left(i, seg_l, seg_r)) return data[0].get(args...);
       }
-      return _query_point(x, get_left(i), seg_l, mid, args...);
+      return _query_point(x, get_left(i, seg_l, seg_r), seg_l, mid, args...);
     } else {
       if constexpr (sparse or persistent) {
-        if (not get_right(i)) return data[0].get(args...);
+        if (not get_right(i, seg_l, seg_r)) return data[0].get(args...);
+      }
+      return _query_point(x, get_right(i, seg_l, seg_r), mid + 1, seg_r, args...);
+    }
+  }
+
+  // Const queries, push into copies of the children instead of the stored nodes
+
+  template <typename... Args>
+  auto query_range(coordinate_t l, coordinate_t r, Args const&... args) const
+      -> return_t<Args...>
+    requires(
+        requires(node_t const nd) { nd.get(args...); } and not persistent and not split_nodes)
+  {
+    if constexpr (check_bounds) {
+      if (r < l) return data[0].get(args...);
+      if (l < 0 || lim <= r) throw std::invalid_argument("query range out of bounds");
+    }
+    return _const_query_range(l, r, data[1], 1, 0, length - 1, args...);
+  }
+
+  template <typename acc_t, typename... Args>
+    requires(has_segment_accumulate<node_t, acc_t, Args...>)
+  auto _const_query_range(
+      coordinate_t const l, coordinate_t const r, node_t const& node, int const i,
+      coordinate_t const seg_l, coordinate_t const seg_r, acc_t const& acc,
+      Args const&... args) const -> return_t<acc_t, Args...> {
+    if constexpr (has_segment_accumulate_without_length<node_t, acc_t, Args...>) {
+      return _const_query_range_impl(
+          l, r, node, i, seg_l, seg_r, node.accumulate(acc, args...), args...);
+    } else {
+      return _const_query_range_impl(
+          l, r, node, i, seg_l, seg_r,
+          node.accumulate(acc, accumulate_length(seg_l, seg_r), args...), args...);
+    }
+  }
+  template <typename... Args>
+  auto _const_query_range(
+      coordinate_t const l, coordinate_t const r, node_t const& node, int const i,
+      coordinate_t const seg_l, coordinate_t const seg_r, Args const&... args) const
+      -> return_t<Args...> {
+    return _const_query_range_impl(l, r, node, i, seg_l, seg_r, args...);
+  }
+  template <typename... Args>
+  auto _const_query_range_impl(
+      coordinate_t const l, coordinate_t const r, node_t const& node, int const i,
+      coordinate_t const seg_l, coordinate_t const seg_r, Args const&... args) const
+      -> return_t<Args...> {
+    if (l <= seg_l && seg_r <= r) return node.get(args...);
+    coordinate_t const mid = (seg_l + seg_r) / 2;
+    int const left_i = get_left(i, seg_l, seg_r);
+    int const right_i = get_right(i, seg_l, seg_r);
+    bool go_left = (l <= mid);
+    bool go_right = (mid < r);
+    auto const query_children = [&](node_t const& left, node_t const& right) {
+      if (not go_right) return _const_query_range(l, r, left, left_i, seg_l, mid, args...);
+      if (not go_left) return _const_query_range(l, r, right, right_i, mid + 1, seg_r, args...);
+      return _merge(
+          _const_query_range(l, r, left, left_i, seg_l, mid, args...),
+          _const_query_range(l, r, right, right_i, mid + 1, seg_r, args...), args...);
+    };
+    if constexpr (has_push) {
+      node_t parent = node, left = data[left_i], right = data[right_i];
+      _push_node(parent, left, right, seg_l, seg_r);
+      return query_children(left, right);
+    } else {
+      if constexpr (sparse) {
+        go_left &= (left_i != 0);
+        go_right &= (right_i != 0);
+        if (not go_left and not go_right) return data[0].get(args...);
       }
-      return _query_point(x, get_right(i), mid + 1, seg_r, args...);
+      return query_children(data[left_i], data[right_i]);
     }
   }
 
+  template <typename... Args>
+  auto query_point(coordinate_t x, Args const&... args) const -> return_t<Args...>
+    requires(
+        requires(node_t const nd) { nd.get(args...); } and not persistent and not split_nodes)
+  {
+    if constexpr (check_bounds) {
+      if (x < 0 || lim <= x) throw std::invalid_argument("query_point index out of bounds");
+    }
+    return _const_query_point(x, data[1], 1, 0, length - 1, args...);
+  }
+
+  template <typename acc_t, typename... Args>
+    requires(has_segment_accumulate<node_t, acc_t, Args...>)
+  auto _const_query_point(
+      coordinate_t const x, node_t const& node, int const i, coordinate_t const seg_l,
+      coordinate_t const seg_r, acc_t const& acc, Args const&... args) const
+      -> return_t<acc_t, Args...> {
+    if constexpr (has_segment_accumulate_without_length<node_t, acc_t, Args...>) {
+      return _const_query_point_impl(
+          x, node, i, seg_l, seg_r, node.accumulate(acc, args...), args...);
+    } else {
+      return _const_query_point_impl(
+          x, node, i, seg_l, seg_r,
+          node.accumulate(acc, accumulate_length(seg_l, seg_r), args...), args...);
+    }
+  }
+  template <typename... Args>
+  auto _const_query_point(
+      coordinate_t const x, node_t const& node, int const i, coordinate_t const seg_l,
+      coordinate_t const seg_r, Args const&... args) const -> return_t<Args...> {
+    return _const_query_point_impl(x, node, i, seg_l, seg_r, args...);
+  }
+  template <typename... Args>
+  auto _const_query_point_impl(
+      coordinate_t const x, node_t const& node, int const i, coordinate_t const seg_l,
+      coordinate_t const seg_r, Args const&... args) const -> return_t<Args...> {
+    if (seg_l == seg_r) return node.get(args...);
+    coordinate_t const mid = (seg_l + seg_r) / 2;
+    int const left_i = get_left(i, seg_l, seg_r);
+    int const right_i = get_right(i, seg_l, seg_r);
+    if constexpr (has_push) {
+      node_t parent = node, left = data[left_i], right = data[right_i];
+      _push_node(parent, left, right, seg_l, seg_r);
+      if (x <= mid) return _const_query_point(x, left, left_i, seg_l, mid, args...);
+      else return _const_query_point(x, right, right_i, mid + 1, seg_r, args...);
+    } else {
+      int const child_i = (x <= mid ? left_i : right_i);
+      if constexpr (sparse) {
+        if (not child_i) return data[0].get(args...);
+      }
+      if (x <= mid) return _const_query_point(x, data[child_i], child_i, seg_l, mid, args...);
+      else return _const_query_point(x, data[child_i], child_i, mid + 1, seg_r, args...);
+    }
+  }
+
+  // left and right cover [seg_l, mid] and [mid + 1, seg_r]
+  template <typename parent_t, typename left_t, typename right_t>
+  auto _push_node(
+      parent_t&& parent, left_t&& left, right_t&& right, coordinate_t const seg_l,
+      coordinate_t const seg_r) const -> void {
+    if constexpr (has_push_with_child_lengths) {
+      coordinate_t const mid = (seg_l + seg_r) / 2;
+      parent.push(left, right, segment_length(seg_l, mid), segment_length(mid + 1, seg_r));
+    } else if constexpr (has_push_with_length) {
+      parent.push(left, right, segment_length(seg_l, seg_r));
+    } else {
+      parent.push(left, right);
+    }
+  }
+
+  // Batches
+
+  // queries in order of l, so that consecutive queries find most of their path in the cache
+  template <typename output_it, typename... Args>
+  auto query_ranges(
+      std::span<std::pair<coordinate_t, coordinate_t> const> ranges, output_it out,
+      Args const&... args) -> output_it
+    requires(requires(node_t nd) { nd.get(args...); } and not persistent)
+  {
+    struct query_t {
+      coordinate_t l, r;
+      int k;
+    };
+    if (std::ranges::is_sorted(ranges, {}, [](auto const& lr) { return lr.first; })) {
+      for (auto const& [l, r] : ranges) *out++ = query_range(l, r, args...);
+      return out;
+    }
+    // counting sort on the top log2(q) bits of l, nearby is enough for the cache
+    int const shift = std::max(
+        0, int(std::bit_width((uint64_t)length - 1)) - int(std::bit_width(ranges.size())));
+    auto const bucket = [&](coordinate_t l) {
+      return size_t(std::clamp<coordinate_t>(l, 0, length - 1) >> shift);
+    };
+    std::vector<int> start(((size_t)(length - 1) >> shift) + 2);
+    for (auto const& [l, r] : ranges) start[bucket(l) + 1]++;
+    std::partial_sum(start.begin(), start.end(), start.begin());
+    std::vector<query_t> order(ranges.size());
+    for (int k = 0; k < (int)ranges.size(); k++) {
+      auto const [l, r] = ranges[k];
+      order[start[bucket(l)]++] = {l, r, k};
+    }
+    if constexpr (std::random_access_iterator<output_it>) {
+      for (auto const& [l, r, k] : order) out[k] = query_range(l, r, args...);
+      return out + (std::iter_difference_t<output_it>)ranges.size();
+    } else {
+      std::vector<return_t<Args...>> results;
+      results.reserve(ranges.size());
+      std::vector<int> position(ranges.size());
+      for (auto const& [l, r, k] : order) {
+        position[k] = (int)results.size();
+        results.push_back(query_range(l, r, args...));
+      }
+      for (int const p : position) *out++ = std::move(results[p]);
+      return out;
+    }
+  }
+
+  template <std::ranges::random_access_range update_range_t>
+  auto update_points(update_range_t const& updates) -> void
+    requires(not persistent)
+  {
+    std::vector<int> batch(std::ranges::size(updates));
+    std::iota(batch.begin(), batch.end(), 0);
+    if constexpr (check_bounds) {
+      for (auto const& update : updates) {
+        auto const x = std::get<0>(update);
+        if (x < 0 || lim <= x) throw std::invalid_argument("update_point index out of bounds");
+      }
+    }
+    std::stable_sort(batch.begin(), batch.end(), [&](int a, int b) {
+      return std::get<0>(updates[a]) < std::get<0>(updates[b]);
+    });
+    if (not batch.empty()) {
+      _update_points(updates, batch.data(), batch.data() + batch.size(), 1, 0, length - 1);
+    }
+  }
+  template <typename update_range_t>
+  auto _update_points(
+      update_range_t const& updates, int const* first, int const* last, int const i,
+      coordinate_t const seg_l, coordinate_t const seg_r) -> void {
+    visit(seg_l, seg_r);
+    if (seg_l == seg_r) {
+      for (; first != last; first++) {
+        std::apply(
+            [&](auto const&, auto const&... args) {
+              static_assert(
+                  not requires(node_t nd) { nd.put_point(args...); } and
+                      not requires(node_t nd, segment_length_t sl) {
+                        nd.put_point(sl, args...);
+                      },
+                  "update_points does not support put_point");
+              if constexpr (requires(node_t nd) { nd.put(args...); }) put(i, args...);
+              else put(i, segment_length(seg_l, seg_r), args...);
+            },
+            updates[*first]);
+      }
+      return;
+    }
+    if constexpr (has_push) push(i, seg_l, seg_r);
+    coordinate_t const mid = (seg_l + seg_r) / 2;
+    int const* split = std::partition_point(
+        first, last, [&](int k) { return std::get<0>(updates[k]) <= mid; });
+    if (first != split) {
+      if constexpr (sparse) this->make_left(i);
+      _update_points(updates, first, split, get_left(i, seg_l, seg_r), seg_l, mid);
+    }
+    if (split != last) {
+      if constexpr (sparse) this->make_right(i);
+      _update_points(updates, split, last, get_right(i, seg_l, seg_r), mid + 1, seg_r);
+    }
+    if constexpr (has_pull) pull(i, seg_l, seg_r);
+  }
+
+  // an update of apply_updates, with its range copied so that the walk reads it in order
+  struct batch_update_t {
+    coordinate_t l, r;
+    int k;
+  };
+  // the batches of the children of the node at some depth on the current path
+  struct batch_level_t {
+    std::vector<batch_update_t> left, right;
+  };
+  template <std::ranges::random_access_range update_range_t>
+  auto apply_updates(update_range_t const& updates) -> void
+    requires(not persistent)
+  {
+    std::vector<batch_update_t> batch;
+    batch.reserve(std::ranges::size(updates));
+    for (int k = 0; k < (int)std::ranges::size(updates); k++) {
+      coordinate_t const l = std::get<0>(updates[k]), r = std::get<1>(updates[k]);
+      if (r < l) continue;  // empty range
+      if constexpr (check_bounds) {
+        if (l < 0 || lim <= r) throw std::invalid_argument("update range out of bounds");
+      }
+      batch.push_back({l, r, k});
+    }
+    if (batch.empty()) return;
+    std::vector<batch_level_t> scratch(std::bit_width((uint64_t)length - 1) + 1);
+    _apply_updates(updates, scratch, batch.data(), batch.data() + batch.size(), 1, 0,
+        length - 1, 0);
+  }
+  // the updates covering the whole segment are put in order, the ones between them are
+  // split into scratch[depth] in a single pass and pushed down to the children together
+  template <typename update_range_t>
+  auto _apply_updates(
+      update_range_t const& updates, std::vector<batch_level_t>& scratch,
+      batch_update_t const* const first, batch_update_t const* const last, int const i,
+      coordinate_t const seg_l, coordinate_t const seg_r, int const depth) -> void {
+    if (last - first == 1) {  // nothing to share, same walk as update_range
+      std::apply(
+          [&](auto const&, auto const&, auto const&... args) {
+            _update_range(first->l, first->r, i, seg_l, seg_r, args...);
+          },
+          updates[first->k]);
+      return;
+    }
+    visit(seg_l, seg_r);
+    coordinate_t const mid = (seg_l + seg_r) / 2;
+    auto& [left, right] = scratch[depth];
+    size_t const left_base = left.size(), right_base = right.size();
+    for (batch_update_t const* it = first; it != last; it++) {
+      if (not(it->l <= seg_l && seg_r <= it->r)) {
+        if (it->l <= mid) left.push_back(*it);
+        if (mid < it->r) right.push_back(*it);
+        continue;
+      }
+      _apply_children(updates, scratch, left_base, right_base, i, seg_l, seg_r, depth);
+      std::apply(
+          [&](auto const&, auto const&, auto const&... args) {
+            static_assert(
+                not requires(node_t nd) { nd.update_break_cond(args...); } and
+                    not requires(node_t nd) { nd.update_put_cond(args...); },
+                "apply_updates does not support update_break_cond/update_put_cond");
+            if constexpr (requires(node_t nd) { nd.put(args...); }) put(i, args...);
+            else put(i, segment_length(seg_l, seg_r), args...);
+          },
+          updates[it->k]);
+    }
+    _apply_children(updates, scratch, left_base, right_base, i, seg_l, seg_r, depth);
+  }
+  // pushes the updates gathered in scratch[depth] past left_base/right_base to the children
+  // and removes them
+  template <typename update_range_t>
+  auto _apply_children(
+      update_range_t const& updates, std::vector<batch_level_t>& scratch,
+      size_t const left_base, size_t const right_base, int const i, coordinate_t const seg_l,
+      coordinate_t const seg_r, int const depth) -> void {
+    auto& [left, right] = scratch[depth];
+    bool const go_left = left.size() != left_base, go_right = right.size() != right_base;
+    if (not go_left and not go_right) return;
+    if constexpr (has_push) push(i, seg_l, seg_r);
+    if constexpr (sparse) {
+      if (go_left) this->make_left(i);
+      if (go_right) this->make_right(i);
+    }
+    coordinate_t const mid = (seg_l + seg_r) / 2;
+    auto const apply_left = [&](std::vector<batch_level_t>& left_scratch) {
+      _apply_updates(
+          updates, left_scratch, left.data() + left_base, left.data() + left.size(),
+          get_left(i, seg_l, seg_r), seg_l, mid, depth + 1);
+    };
+    auto const apply_right = [&] {
+      _apply_updates(
+          updates, scratch, right.data() + right_base, right.data() + right.size(),
+          get_right(i, seg_l, seg_r), mid + 1, seg_r, depth + 1);
+    };
+#if defined(SEGMENT_TREE_PARALLEL_UPDATES)
+    if constexpr (normal and not journaled and not instrumented) {
+      if (left.size() - left_base + right.size() - right_base >=
+              size_t(SEGMENT_TREE_PARALLEL_UPDATES) and
+          size_t(1) << depth < parallel_threads() and go_left and go_right) {
+        {
+          // the worker gets its own scratch, both batches stay in place at this depth
+          std::jthread worker([&] {
+            std::vector<batch_level_t> worker_scratch(scratch.size());
+            apply_left(worker_scratch);
+          });
+          apply_right();
+        }
+        left.resize(left_base), right.resize(right_base);
+        if constexpr (has_pull) pull(i, seg_l, seg_r);
+        return;
+      }
+    }
+#endif
+    if (go_left) apply_left(scratch);
+    if (go_right) apply_right();
+    left.resize(left_base), right.resize(right_base);
+    if constexpr (has_pull) pull(i, seg_l, seg_r);
+  }
+
   // Binary search
 
   template <typename... Args>
@@ -615,7 +1510,8 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
       if (r < l) return lim;
       if (l < 0 || lim <= r) throw std::invalid_argument("search_left out of bounds");
     }
-    return _search_left(l, r, 1, 0, length - 1, args...);
+    if constexpr (iterative) return _iterative_search<true>(l, r, args...);
+    else return _search_left(l, r, 1, 0, length - 1, args...);
   }
   template <typename... Args>
   auto search_left(int version, coordinate_t l, coordinate_t r, Args... args) -> coordinate_t
@@ -624,7 +1520,7 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
     if constexpr (check_bounds) {
       if (r < l) return lim;
       if (l < 0 || lim <= r) throw std::invalid_argument("search_left out of bounds");
-      if (version >= (int)this->version_roots.size()) {
+      if (not this->has_version(version)) {
         throw std::invalid_argument("version does not exist");
       }
     }
@@ -634,20 +1530,21 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
   auto _search_left(
       coordinate_t const l, coordinate_t const r, int const i, coordinate_t const seg_l,
       coordinate_t const seg_r, Args&... args) -> coordinate_t {
+    visit(seg_l, seg_r);
     if (l <= seg_l && seg_r <= r && not data[i].contains(args...)) return lim;
     if (seg_l == seg_r) return seg_l;
-    if constexpr (has_push_with_length) push(i, segment_length_t{seg_r - seg_l + 1});
-    if constexpr (has_push_no_length) push(i);
+    if constexpr (has_push) push(i, seg_l, seg_r);
     coordinate_t const mid = (seg_l + seg_r) / 2;
     bool go_left = (l <= mid);
     bool go_right = (mid < r);
     if constexpr (sparse or persistent) {
-      go_left &= (get_left(i) != 0);
-      go_right &= (get_right(i) != 0);
+      go_left &= (get_left(i, seg_l, seg_r) != 0);
+      go_right &= (get_right(i, seg_l, seg_r) != 0);
     }
-    coordinate_t res = (go_left ? _search_left(l, r, get_left(i), seg_l, mid, args...) : lim);
+    coordinate_t res =
+        (go_left ? _search_left(l, r, get_left(i, seg_l, seg_r), seg_l, mid, args...) : lim);
     if (res == lim && go_right) {
-      res = _search_left(l, r, get_right(i), mid + 1, seg_r, args...);
+      res = _search_left(l, r, get_right(i, seg_l, seg_r), mid + 1, seg_r, args...);
     }
     return res;
   }
@@ -660,7 +1557,8 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
       if (r < l) return lim;
       if (l < 0 || lim <= r) throw std::invalid_argument("search_right out of bounds");
     }
-    return _search_right(l, r, 1, 0, length - 1, args...);
+    if constexpr (iterative) return _iterative_search<false>(l, r, args...);
+    else return _search_right(l, r, 1, 0, length - 1, args...);
   }
   template <typename... Args>
   auto search_right(int version, coordinate_t l, coordinate_t r, Args... args) -> coordinate_t
@@ -669,7 +1567,7 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
     if constexpr (check_bounds) {
       if (r < l) return lim;
       if (l < 0 || lim <= r) throw std::invalid_argument("search_right out of bounds");
-      if (version >= (int)this->version_roots.size()) {
+      if (not this->has_version(version)) {
         throw std::invalid_argument("version does not exist");
       }
     }
@@ -679,22 +1577,97 @@ struct segment_tree : segment_tree_data<Node_t, traits> {
   auto _search_right(
       coordinate_t const l, coordinate_t const r, int const i, coordinate_t const seg_l,
       coordinate_t const seg_r, Args&... args) -> coordinate_t {
+    visit(seg_l, seg_r);
     if (l <= seg_l && seg_r <= r && not data[i].contains(args...)) return lim;
     if (seg_l == seg_r) return seg_l;
-    if constexpr (has_push_with_length) push(i, segment_length_t{seg_r - seg_l + 1});
-    if constexpr (has_push_no_length) push(i);
+    if constexpr (has_push) push(i, seg_l, seg_r);
     coordinate_t const mid = (seg_l + seg_r) / 2;
     bool go_left = (l <= mid);
     bool go_right = (mid < r);
     if constexpr (sparse or persistent) {
-      go_left &= (get_left(i) != 0);
-      go_right &= (get_right(i) != 0);
+      go_left &= (get_left(i, seg_l, seg_r) != 0);
+      go_right &= (get_right(i, seg_l, seg_r) != 0);
     }
     coordinate_t res =
-        (go_right ? _search_right(l, r, get_right(i), mid + 1, seg_r, args...) : lim);
+        (go_right ? _search_right(l, r, get_right(i, seg_l, seg_r), mid + 1, seg_r, args...)
+                  : lim);
     if (res == lim && go_left) {
-      res = _search_right(l, r, get_left(i), seg_l, mid, args...);
+      res = _search_right(l, r, get_left(i, seg_l, seg_r), seg_l, mid, args...);
     }
     return res;
   }
+
+  // Iterative (bottom-up), normal layout without push
+
+  template <typename... Args>
+  auto _iterative_update_point(int x, Args const&... args) -> void {
+    int i = length + x;
+    segment_length_t seg_len{1};
+    if constexpr (requires { data[i].put(args...); }) put(i, args...);
+    else put(i, seg_len, args...);
+    while (true) {
+      visit(0, coordinate_t(seg_len.value) - 1);
+      if constexpr (requires { data[i].put_point(args...); }) {
+        put_point(i, args...);
+      } else if constexpr (requires { data[i].put_point(seg_len, args...); }) {
+        put_point(i, seg_len, args...);
+      }
+      if ((i /= 2) == 0) break;
+      seg_len.value *= 2;
+      if constexpr (has_pull) {
+        if constexpr (instrumented) this->stats.pulls++;
+        save(i);
+        data[i].pull(data[get_left(i)], data[get_right(i)]);
+      }
+    }
+  }
+
+  template <typename... Args>
+  auto _iterative_query_range(int l, int r, Args const&... args) -> return_t<Args...>
+    requires(not has_accumulate<Args...>)
+  {
+    std::optional<return_t<Args...>> res_l, res_r;
+    for (l += length, r += length + 1; l < r; l /= 2, r /= 2) {
+      if constexpr (instrumented) this->stats.visits += (l & 1) + (r & 1);
+      if (l & 1) {
+        res_l = res_l ? _merge(*res_l, data[l].get(args...), args...) : data[l].get(args...);
+        l++;
+      }
+      if (r & 1) {
+        r--;
+        res_r = res_r ? _merge(data[r].get(args...), *res_r, args...) : data[r].get(args...);
+      }
+    }
+    if (not res_l) return *res_r;
+    if (not res_r) return *res_l;
+    return _merge(*res_l, *res_r, args...);
+  }
+
+  template <bool from_left, typename... Args>
+  auto _iterative_search(int l, int r, Args&... args) -> int {
+    // canonical nodes of [l, r] in search order, at most 2 per level
+    int nodes[64], left_size = 0, right_size = 0, right_nodes[32];
+    for (l += length, r += length + 1; l < r; l /= 2, r /= 2) {
+      if (l & 1) nodes[left_size++] = l++;
+      if (r & 1) right_nodes[right_size++] = --r;
+    }
+    int size = left_size;
+    for (int k = right_size - 1; k >= 0; k--) nodes[size++] = right_nodes[k];
+    if constexpr (not from_left) std::reverse(nodes, nodes + size);
+    for (int k = 0; k < size; k++) {
+      int i = nodes[k];
+      if constexpr (instrumented) this->stats.visits++;
+      if (not data[i].contains(args...)) continue;
+      while (i < length) {
+        if constexpr (instrumented) this->stats.visits += 2;
+        int const first = from_left ? get_left(i) : get_right(i);
+        int const second = from_left ? get_right(i) : get_left(i);
+        if (data[first].contains(args...)) i = first;
+        else if (data[second].contains(args...)) i = second;
+        else break;
+      }
+      if (i >= length) return i - length;
+    }
+    return lim;
+  }
 };
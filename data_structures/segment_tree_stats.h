@@ -0,0 +1,71 @@
+/* Segment Tree Stats
+ * USAGE
+ *  segment_tree<node_t, INSTRUMENTED> segtree(n); counts into segtree.stats
+ *  segment_tree_stats::total(); sum of the stats of the destroyed instrumented trees
+ *  std::cerr << stats; prints the counters on one line
+ * MEMBERS
+ *  visits; nodes entered by the recursion (or the ITERATIVE loops)
+ *  pushes, pulls, puts (put and put_point), breaks (update_break_cond was true)
+ *  allocations; nodes created by SPARSE and PERSISTENT
+ *  max_depth; deepest node visited, from its segment length
+ * NOTES
+ *  with PRINT_SEGMENT_TREE_STATS, main.h prints and resets total() after each SOLVE()
+ *  build() and the const queries are not counted. a copy of a tree starts from zero
+ * STATUS
+ *  untested
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstddef>
+#include <ostream>
+#include <utility>
+
+struct segment_tree_stats {
+  size_t visits = 0;
+  size_t pushes = 0;
+  size_t pulls = 0;
+  size_t puts = 0;
+  size_t breaks = 0;
+  size_t allocations = 0;
+  int max_depth = 0;
+
+  static auto total() -> segment_tree_stats& {
+    static segment_tree_stats stats;
+    return stats;
+  }
+  auto operator+=(segment_tree_stats const& o) -> segment_tree_stats& {
+    visits += o.visits;
+    pushes += o.pushes;
+    pulls += o.pulls;
+    puts += o.puts;
+    breaks += o.breaks;
+    allocations += o.allocations;
+    max_depth = std::max(max_depth, o.max_depth);
+    return *this;
+  }
+  friend auto operator<<(std::ostream& os, segment_tree_stats const& s) -> std::ostream& {
+    return os << "visits=" << s.visits << " pushes=" << s.pushes << " pulls=" << s.pulls
+              << " puts=" << s.puts << " breaks=" << s.breaks
+              << " allocations=" << s.allocations << " max_depth=" << s.max_depth;
+  }
+};
+
+template <bool instrumented>
+struct segment_tree_counters {};
+
+template <>
+struct segment_tree_counters<true> {
+  segment_tree_stats stats;
+  segment_tree_counters() = default;
+  // a copy starts from zero and a move takes the counters, so total() sees each count once
+  segment_tree_counters(segment_tree_counters const&) {}
+  segment_tree_counters(segment_tree_counters&& o) noexcept
+      : stats(std::exchange(o.stats, {})) {}
+  auto operator=(segment_tree_counters const&) -> segment_tree_counters& { return *this; }
+  auto operator=(segment_tree_counters&& o) noexcept -> segment_tree_counters& {
+    stats += std::exchange(o.stats, {});
+    return *this;
+  }
+  ~segment_tree_counters() { segment_tree_stats::total() += stats; }
+};
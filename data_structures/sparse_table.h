@@ -1,11 +1,18 @@
 /* Sparse Table
  * USAGE
  *  sparse_table<Type, Functional> rq(arr);
+ *  sparse_table<Type, Functional> rq(begin, end, func); func is copied and used for every call
  *  auto val = rq.query(l, r);
  *    inclusive range [l, r]
  *    assumes l <= r
  * CONSTRUCTOR
  *  arr: array on which to build the sparse table
+ * NOTES
+ *  each layer is built by one flat loop over raw pointers, which the compiler vectorizes for
+ *  arithmetic types and simple Functionals (min, max, &, |)
+ * PARALLEL BUILD
+ *  define SPARSE_TABLE_PARALLEL_BUILD as the minimum layer length to split a layer across
+ *  all threads (eg. -D SPARSE_TABLE_PARALLEL_BUILD="1<<20")
  * TIME
  *  O(NlogN) construction, O(Functional) query
  *  N = |array|
@@ -14,24 +21,51 @@
  */
 #pragma once
 
+#include <algorithm>
 #include <bit>
+#include <cstddef>
+#include <iterator>
+#include <ranges>
+#include <utility>
 #include <vector>
 
+#if defined(SPARSE_TABLE_PARALLEL_BUILD)
+#include "utility/parallel_for.h"
+#endif
+
 template <typename T, typename Func>
 struct sparse_table {
   size_t const n;
   std::vector<T> data;
+  [[no_unique_address]] mutable Func func;  // mutable, Func::operator() need not be const
   template <std::input_iterator input_it>
-  sparse_table(input_it s, input_it t) : n(std::distance(s, t)), data(n * std::bit_width(n)) {
+  sparse_table(input_it s, input_it t, Func _func = Func())
+      : n(std::distance(s, t)), data(n * std::bit_width(n)), func(std::move(_func)) {
     std::copy(s, t, data.begin());
     for (size_t j = 1; j < std::bit_width(n); j++) {
-      for (size_t i = 0; i + (1 << j) <= n; i++) {
-        data[j * n + i] = Func()(data[(j - 1) * n + i], data[(j - 1) * n + i + (1 << (j - 1))]);
+      size_t const half = size_t(1) << (j - 1), count = n + 1 - 2 * half;
+      T const* const prev = data.data() + (j - 1) * n;
+      T* const cur = data.data() + j * n;
+#if defined(SPARSE_TABLE_PARALLEL_BUILD)
+      if (count >= size_t(SPARSE_TABLE_PARALLEL_BUILD)) {
+        parallel_for(0, count, [&](size_t lo, size_t hi) {
+          _build_layer(prev + lo, cur + lo, hi - lo, half);
+        });
+        continue;
       }
+#endif
+      _build_layer(prev, cur, count, half);
     }
   }
+  template <std::ranges::input_range range_t>
+  sparse_table(range_t const& arr, Func _func = Func())
+      : sparse_table(std::ranges::begin(arr), std::ranges::end(arr), std::move(_func)) {}
+  // cur[i] = func(prev[i], prev[i + half]) for i in [0, count)
+  auto _build_layer(T const* prev, T* cur, size_t count, size_t half) -> void {
+    for (size_t i = 0; i < count; i++) cur[i] = func(prev[i], prev[i + half]);
+  }
   auto query(size_t l, size_t r) const -> T {
     auto const layer = std::bit_width(r + 1 - l) - 1;
-    return Func()(data[layer * n + l], data[layer * n + r + 1 - (1 << layer)]);
+    return func(data[layer * n + l], data[layer * n + r + 1 - (size_t(1) << layer)]);
   }
 };
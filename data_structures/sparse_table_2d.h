@@ -0,0 +1,63 @@
+/* 2D Sparse Table
+ * USAGE
+ *  sparse_table_2d<Type, Functional> rq(arr); arr is an nd_array<Type, 2> (utility/nd_array.h)
+ *  sparse_table_2d<Type, Functional> rq(arr, func); func is copied and used for every call
+ *  auto val = rq.query(r1, c1, r2, c2);
+ *    inclusive submatrix [r1, r2] x [c1, c2]
+ *    assumes r1 <= r2 and c1 <= c2
+ * NOTES
+ *  Functional must be idempotent (min, max, gcd, &, |), a query overlaps four squares.
+ *  one nd_array<Type, 4> indexed (row layer, column layer, row, column), so every layer is
+ *  a contiguous n x m plane and is built row by row with flat loops the compiler vectorizes
+ * TIME
+ *  O(NMlogNlogM) construction, O(Functional) query
+ *  N, M = dimensions of arr
+ * STATUS
+ *  untested
+ */
+#pragma once
+
+#include "utility/nd_array.h"
+
+#include <algorithm>
+#include <bit>
+#include <cstddef>
+#include <tuple>
+#include <utility>
+
+template <typename T, typename Func>
+struct sparse_table_2d {
+  size_t const n, m;
+  nd_array<T, 4> data;
+  [[no_unique_address]] mutable Func func;  // mutable, Func::operator() need not be const
+  sparse_table_2d(nd_array<T, 2> const& arr, Func _func = Func())
+      : n(std::get<0>(arr.dims())),
+        m(std::get<1>(arr.dims())),
+        data(std::bit_width(n), std::bit_width(m), n, m),
+        func(std::move(_func)) {
+    std::copy(arr.data.begin(), arr.data.end(), data.data.begin());
+    for (size_t kr = 0; kr < std::bit_width(n); kr++) {
+      for (size_t kc = 0; kc < std::bit_width(m); kc++) {
+        if (kr == 0 && kc == 0) continue;
+        // halves along the rows if kr > 0, else along the columns
+        size_t const offset = kr ? (size_t(1) << (kr - 1)) * m : size_t(1) << (kc - 1);
+        size_t const rows = n + 1 - (size_t(1) << kr), cols = m + 1 - (size_t(1) << kc);
+        for (size_t i = 0; i < rows; i++) {
+          T const* const prev = kr ? &data(kr - 1, kc, i, 0) : &data(0, kc - 1, i, 0);
+          _build_row(prev, prev + offset, &data(kr, kc, i, 0), cols);
+        }
+      }
+    }
+  }
+  // out[j] = func(a[j], b[j]) for j in [0, count)
+  auto _build_row(T const* a, T const* b, T* out, size_t count) -> void {
+    for (size_t j = 0; j < count; j++) out[j] = func(a[j], b[j]);
+  }
+  auto query(size_t r1, size_t c1, size_t r2, size_t c2) const -> T {
+    size_t const kr = std::bit_width(r2 + 1 - r1) - 1, kc = std::bit_width(c2 + 1 - c1) - 1;
+    size_t const r3 = r2 + 1 - (size_t(1) << kr), c3 = c2 + 1 - (size_t(1) << kc);
+    return func(
+        func(data(kr, kc, r1, c1), data(kr, kc, r1, c3)),
+        func(data(kr, kc, r3, c1), data(kr, kc, r3, c3)));
+  }
+};
@@ -0,0 +1,195 @@
+/* Static Segment Tree
+ * USAGE
+ *  static_segment_tree<node_t, N> segtree; segment tree with N leaves, no allocation
+ *  static_segment_tree<node_t, N> segtree(begin, end); initializes with given values
+ *  node_t is the same as for segment_tree (data_structures/segment_tree.h)
+ *    ie. put, get, merge, pull, push, contains, put and push may take segment_length_t
+ *    no accumulate, beats conditions or put_point
+ * MEMBERS
+ *  update_range(l, r, value...);
+ *  update_point(x, value...);
+ *  query_range(l, r, ...);
+ *  query_point(x, ...);
+ *  search_left(l, r, ...); returns N if not found
+ *  All ranges are inclusive, every member is constexpr
+ * NOTES
+ *  nodes live in a std::array and the depth is a template parameter of the recursion,
+ *  so the descent is fully unrolled for small N. meant for many small trees (N <= 4096)
+ * TIME
+ *  O(logN) per operation
+ * STATUS
+ *  untested
+ */
+#pragma once
+
+#include "data_structures/segment_tree.h"
+
+#include <array>
+#include <bit>
+#include <iterator>
+#include <stdexcept>
+#include <type_traits>
+
+template <typename Node_t, int N>
+  requires(0 < N)
+struct static_segment_tree {
+  using node_t = Node_t;
+  template <typename... Args>
+  using return_t = segment_tree_details::return_getter<node_t, Args...>::type;
+
+  static constexpr int lim = N;
+  static constexpr int length = (int)std::bit_ceil((unsigned)N);
+  static constexpr int height = std::countr_zero((unsigned)length);
+
+  static constexpr bool has_push_no_length =
+      requires(node_t nd, node_t& nd_ref) { nd.push(nd_ref, nd_ref); };
+  static constexpr bool has_push_with_length =
+      requires(node_t nd, node_t& nd_ref, segment_length_t sl) { nd.push(nd_ref, nd_ref, sl); };
+  static constexpr bool has_push_with_child_lengths =
+      requires(node_t nd, node_t& nd_ref, segment_length_t sl) {
+        nd.push(nd_ref, nd_ref, sl, sl);
+      };
+  static constexpr bool has_push =
+      has_push_no_length or has_push_with_length or has_push_with_child_lengths;
+  static constexpr bool has_pull =
+      requires(node_t nd, node_t const& nd_cref) { nd.pull(nd_cref, nd_cref); };
+  template <typename... Args>
+  static constexpr bool use_pull_as_merge =
+      has_pull && not requires(return_t<Args...> ret, Args const&... args) {
+        node_t::merge(ret, ret, args...);
+      } && std::is_same_v<node_t, return_t<Args...>>;
+
+  std::array<node_t, 2 * length> data{};
+
+  constexpr static_segment_tree() = default;
+  template <std::input_iterator input_it>
+  constexpr static_segment_tree(input_it s, input_it t) {
+    for (int i = length; s != t && i < length + N; s++, i++) data[i] = *s;
+    build();
+  }
+
+  constexpr auto root() -> node_t& { return data[1]; }
+  constexpr auto build() -> void {
+    if constexpr (has_pull) {
+      for (int i = length - 1; i > 0; i--) data[i].pull(data[2 * i], data[2 * i + 1]);
+    }
+  }
+
+  template <int seg_len>
+  constexpr auto push(int i) -> void {
+    if constexpr (has_push_with_child_lengths) {
+      data[i].push(
+          data[2 * i], data[2 * i + 1], segment_length_t{seg_len / 2},
+          segment_length_t{seg_len / 2});
+    } else if constexpr (has_push_with_length) {
+      data[i].push(data[2 * i], data[2 * i + 1], segment_length_t{seg_len});
+    } else if constexpr (has_push_no_length) {
+      data[i].push(data[2 * i], data[2 * i + 1]);
+    }
+  }
+  constexpr auto pull(int i) -> void {
+    if constexpr (has_pull) data[i].pull(data[2 * i], data[2 * i + 1]);
+  }
+  template <typename... Args>
+  static constexpr auto _merge(
+      return_t<Args...> const& left, return_t<Args...> const& right, Args const&... args)
+      -> return_t<Args...> {
+    if constexpr (use_pull_as_merge<Args...>) {
+      node_t res;
+      res.pull(left, right);
+      return res;
+    } else {
+      return node_t::merge(left, right, args...);
+    }
+  }
+
+  // Updates
+
+  template <typename... Args>
+  constexpr auto update_range(int l, int r, Args const&... args) -> void {
+    if (r < l) return;  // empty range
+    if (l < 0 || lim <= r) throw std::invalid_argument("update range out of bounds");
+    _update_range<0>(l, r, 1, 0, args...);
+  }
+  template <typename... Args>
+  constexpr auto update_point(int x, Args const&... args) -> void {
+    if (x < 0 || lim <= x) throw std::invalid_argument("update_point index out of bounds");
+    _update_range<0>(x, x, 1, 0, args...);
+  }
+  template <int depth, typename... Args>
+  constexpr auto _update_range(int l, int r, int i, int seg_l, Args const&... args) -> void {
+    constexpr int seg_len = length >> depth;
+    if constexpr (depth < height) {
+      if (not(l <= seg_l && seg_l + seg_len - 1 <= r)) {
+        push<seg_len>(i);
+        int const mid = seg_l + seg_len / 2;
+        if (l < mid) _update_range<depth + 1>(l, r, 2 * i, seg_l, args...);
+        if (mid <= r) _update_range<depth + 1>(l, r, 2 * i + 1, mid, args...);
+        pull(i);
+        return;
+      }
+    }
+    if constexpr (requires { data[i].put(args...); }) data[i].put(args...);
+    else data[i].put(segment_length_t{seg_len}, args...);
+  }
+
+  // Queries
+
+  template <typename... Args>
+  constexpr auto query_range(int l, int r, Args const&... args) -> return_t<Args...>
+    requires(requires(node_t nd) { nd.get(args...); })
+  {
+    if (r < l) return data[0].get(args...);
+    if (l < 0 || lim <= r) throw std::invalid_argument("query range out of bounds");
+    return _query_range<0>(l, r, 1, 0, args...);
+  }
+  template <typename... Args>
+  constexpr auto query_point(int x, Args const&... args) -> return_t<Args...>
+    requires(requires(node_t nd) { nd.get(args...); })
+  {
+    if (x < 0 || lim <= x) throw std::invalid_argument("query_point index out of bounds");
+    return _query_range<0>(x, x, 1, 0, args...);
+  }
+  template <int depth, typename... Args>
+  constexpr auto _query_range(int l, int r, int i, int seg_l, Args const&... args)
+      -> return_t<Args...> {
+    constexpr int seg_len = length >> depth;
+    if constexpr (depth < height) {
+      if (not(l <= seg_l && seg_l + seg_len - 1 <= r)) {
+        push<seg_len>(i);
+        int const mid = seg_l + seg_len / 2;
+        if (r < mid) return _query_range<depth + 1>(l, r, 2 * i, seg_l, args...);
+        if (mid <= l) return _query_range<depth + 1>(l, r, 2 * i + 1, mid, args...);
+        return _merge(
+            _query_range<depth + 1>(l, r, 2 * i, seg_l, args...),
+            _query_range<depth + 1>(l, r, 2 * i + 1, mid, args...), args...);
+      }
+    }
+    return data[i].get(args...);
+  }
+
+  // Binary search
+
+  template <typename... Args>
+  constexpr auto search_left(int l, int r, Args... args) -> int {
+    if (r < l) return lim;
+    if (l < 0 || lim <= r) throw std::invalid_argument("search_left out of bounds");
+    return _search_left<0>(l, r, 1, 0, args...);
+  }
+  template <int depth, typename... Args>
+  constexpr auto _search_left(int l, int r, int i, int seg_l, Args&... args) -> int {
+    constexpr int seg_len = length >> depth;
+    if (l <= seg_l && seg_l + seg_len - 1 <= r && not data[i].contains(args...)) return lim;
+    if constexpr (depth == height) {
+      return seg_l;
+    } else {
+      push<seg_len>(i);
+      int const mid = seg_l + seg_len / 2;
+      int res = (l < mid ? _search_left<depth + 1>(l, r, 2 * i, seg_l, args...) : lim);
+      if (res == lim && mid <= r) {
+        res = _search_left<depth + 1>(l, r, 2 * i + 1, mid, args...);
+      }
+      return res;
+    }
+  }
+};
@@ -0,0 +1,165 @@
+/* Wide Segment Tree
+ * USAGE
+ *  wide_segment_tree<T, Op> segtree(n); initializes n leaves to Op::identity
+ *  wide_segment_tree<T, Op> segtree(begin, end); initializes with given values
+ *  T is arithmetic, Op is one of wide_segment_tree_ops::{sum, min, max} or a class with
+ *    static constexpr T identity;
+ *    static T merge(T l, T r); associative
+ *    static bool contains(T value, T& arg); for search_left, update arg if not
+ * MEMBERS
+ *  update_point(x, value); sets the value at x
+ *  query_point(x);
+ *  query_range(l, r); merge of the values in [l, r]
+ *  search_left(l, r, arg); first x in [l, r] such that the prefix from l contains arg
+ *    sum: sum(l..x) >= arg; min: value <= arg; max: value >= arg
+ *    returns n if not found
+ *  All ranges are inclusive
+ * NOTES
+ *  static (no lazy) tree with fan-out B = 64 / sizeof(T), each node's children are one
+ *  cache line. block scans are fixed-width loops that gcc vectorizes (eg. with -mavx2)
+ * TIME
+ *  O(B log_B N) update_point, query_range, search_left
+ *  N = |array|
+ * STATUS
+ *  untested
+ */
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <type_traits>
+#include <vector>
+
+namespace wide_segment_tree_ops {
+template <typename T>
+struct sum {
+  static constexpr T identity = 0;
+  static auto merge(T l, T r) -> T { return l + r; }
+  static auto contains(T value, T& arg) -> bool {
+    if (arg <= value) return true;
+    arg -= value;
+    return false;
+  }
+};
+template <typename T>
+struct min {
+  static constexpr T identity = std::numeric_limits<T>::max();
+  static auto merge(T l, T r) -> T { return r < l ? r : l; }
+  static auto contains(T value, T const& arg) -> bool { return value <= arg; }
+};
+template <typename T>
+struct max {
+  static constexpr T identity = std::numeric_limits<T>::lowest();
+  static auto merge(T l, T r) -> T { return l < r ? r : l; }
+  static auto contains(T value, T const& arg) -> bool { return arg <= value; }
+};
+}  // namespace wide_segment_tree_ops
+
+template <typename T, typename Op = wide_segment_tree_ops::sum<T>>
+  requires(std::is_arithmetic_v<T>)
+struct wide_segment_tree {
+  static constexpr int B = std::max(2, int(64 / sizeof(T)));
+  struct alignas(64) block_t {
+    T values[B];
+  };
+
+  int const lim;
+  std::vector<std::vector<block_t>> levels;  // levels[0] holds the leaves
+
+  wide_segment_tree(int n) : lim(n) {
+    for (int count = std::max(n, 1);; count = (count + B - 1) / B) {
+      block_t identity_block;
+      std::fill(identity_block.values, identity_block.values + B, Op::identity);
+      levels.emplace_back((count + B - 1) / B, identity_block);
+      if (count <= B) break;
+    }
+  }
+  template <std::input_iterator input_it>
+  wide_segment_tree(input_it s, input_it t) : wide_segment_tree((int)std::distance(s, t)) {
+    for (int i = 0; s != t; s++, i++) {
+      at(0, i) = *s;
+    }
+    build();
+  }
+
+  auto at(int level, int i) -> T& { return levels[level][i / B].values[i % B]; }
+  auto at(int level, int i) const -> T const& { return levels[level][i / B].values[i % B]; }
+  auto root() const -> T { return _reduce(levels.back()[0], 0, B - 1); }
+
+  auto build() -> void {
+    for (int k = 0; k + 1 < (int)levels.size(); k++) {
+      for (int b = 0; b < (int)levels[k].size(); b++) {
+        at(k + 1, b) = _reduce(levels[k][b], 0, B - 1);
+      }
+    }
+  }
+
+  // masked so that the loop has a fixed trip count and vectorizes
+  static auto _reduce(block_t const& block, int lo, int hi) -> T {
+    T res = Op::identity;
+    for (int j = 0; j < B; j++) {
+      res = Op::merge(res, (lo <= j && j <= hi) ? block.values[j] : Op::identity);
+    }
+    return res;
+  }
+
+  auto update_point(int x, T const& value) -> void {
+    if (x < 0 || lim <= x) throw std::invalid_argument("update_point index out of bounds");
+    at(0, x) = value;
+    for (int k = 0; k + 1 < (int)levels.size(); k++, x /= B) {
+      at(k + 1, x / B) = _reduce(levels[k][x / B], 0, B - 1);
+    }
+  }
+
+  auto query_point(int x) const -> T {
+    if (x < 0 || lim <= x) throw std::invalid_argument("query_point index out of bounds");
+    return at(0, x);
+  }
+
+  auto query_range(int l, int r) const -> T {
+    if (r < l) return Op::identity;
+    if (l < 0 || lim <= r) throw std::invalid_argument("query range out of bounds");
+    T res_l = Op::identity, res_r = Op::identity;
+    for (int k = 0;; k++) {
+      int const lb = l / B, rb = r / B;
+      if (lb == rb) {
+        res_l = Op::merge(res_l, _reduce(levels[k][lb], l % B, r % B));
+        break;
+      }
+      res_l = Op::merge(res_l, _reduce(levels[k][lb], l % B, B - 1));
+      res_r = Op::merge(_reduce(levels[k][rb], 0, r % B), res_r);
+      if ((l = lb + 1) > (r = rb - 1)) break;
+    }
+    return Op::merge(res_l, res_r);
+  }
+
+  auto search_left(int l, int r, T arg) const -> int {
+    if (r < l) return lim;
+    if (l < 0 || lim <= r) throw std::invalid_argument("search_left out of bounds");
+    int k = 0, i = l;
+    int64_t span = 1;  // leaves per entry on level k, entry i starts at leaf i * span
+    // climb while the rest of the current block does not contain arg
+    while (true) {
+      int const block_end = (i / B + 1) * B;
+      while (i < block_end && i * span <= r && not Op::contains(at(k, i), arg)) i++;
+      if (i * span > r) return lim;
+      if (i < block_end) break;
+      if (k + 1 == (int)levels.size()) return lim;
+      k++;
+      span *= B;
+      i = block_end / B;
+      if (i >= (int)levels[k].size() * B) return lim;  // past the last entry of the level
+    }
+    // descend into the first child that contains arg
+    while (k > 0) {
+      k--;
+      i *= B;
+      int const block_end = i + B;
+      while (i < block_end && not Op::contains(at(k, i), arg)) i++;
+      if (i == block_end) return lim;
+    }
+    return i <= r ? i : lim;
+  }
+};
@@ -6,9 +6,13 @@
  *  PRINT_CASE -- same as MULTI_TEST except also print "Case PRINT_CASE{i}: ans_i"
  *  FAST_INPUT -- use fast input
  *  FAST_INPUT_BUFFER -- size of buffer for fast_input. default=16384
+ *  PRINT_SEGMENT_TREE_STATS -- print segment_tree_stats::total() after each SOLVE()
  */
 #pragma once
 
+#if defined(PRINT_SEGMENT_TREE_STATS)
+#include "data_structures/segment_tree_stats.h"
+#endif
 #if defined(PRINT_TIMING)
 #include <chrono>
 #endif
@@ -56,6 +60,10 @@ struct solve_main_wrapper {
       auto duration = std::chrono::high_resolution_clock::now() - start_time;
       using namespace std::chrono;
       std::cerr << "[t" << testnum << "] " << duration / 1.0s << "s\n";
+#endif
+#if defined(PRINT_SEGMENT_TREE_STATS)
+      std::cerr << "[s" << testnum << "] " << segment_tree_stats::total() << "\n";
+      segment_tree_stats::total() = {};
 #endif
     }
     return 0;
@@ -0,0 +1,41 @@
+/* Parallel For
+ * USAGE
+ *  parallel_for(begin, end, f); calls f(lo, hi) on disjoint chunks [lo, hi) of [begin, end)
+ *  parallel_for(begin, end, f, threads); at most `threads` chunks
+ *  parallel_threads(); number of hardware threads (at least 1)
+ * NOTES
+ *  one chunk runs on the calling thread, returns once every chunk is done
+ *  runs f(begin, end) directly if there is only one chunk
+ * STATUS
+ *  untested
+ */
+#pragma once
+
+#include <algorithm>
+#include <thread>
+#include <vector>
+
+inline auto parallel_threads() -> size_t {
+  return std::max<size_t>(1, std::thread::hardware_concurrency());
+}
+
+template <typename Func>
+auto parallel_for(size_t begin, size_t end, Func const& f, size_t threads = parallel_threads())
+    -> void {
+  if (end <= begin) return;
+  threads = std::clamp<size_t>(threads, 1, end - begin);
+  if (threads == 1) {
+    f(begin, end);
+    return;
+  }
+  size_t const chunk = (end - begin) / threads, extra = (end - begin) % threads;
+  std::vector<std::jthread> workers;
+  workers.reserve(threads - 1);
+  size_t lo = begin + chunk + (extra > 0);
+  for (size_t t = 1; t < threads; t++) {
+    size_t const hi = lo + chunk + (t < extra);
+    workers.emplace_back([&f, lo, hi] { f(lo, hi); });
+    lo = hi;
+  }
+  f(begin, begin + chunk + (extra > 0));
+}